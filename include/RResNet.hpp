@@ -97,7 +97,7 @@ namespace snn
 
             snn::SIMDVectorLite<HiddenStateSize> delta_k = this->delta.fire(input);
 
-            number B_u = (B*input).reduce();
+            number B_u = B.dot(input);
 
             snn::SIMDVectorLite<HiddenStateSize>  dB_u = delta_k*B_u;
 
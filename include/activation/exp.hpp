@@ -11,13 +11,13 @@ namespace snn
 
         static inline void activate(SIMDVector& vec)
         {
-            exp(vec);
+            vec=exp(vec);
         }
 
         template<size_t Size>
         static inline void activate(SIMDVectorLite<Size>& vec)
         {
-            exp(vec);
+            vec=exp(vec);
         }
 
         static inline void inverse(SIMDVector& vec)
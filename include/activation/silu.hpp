@@ -11,17 +11,13 @@ namespace snn
 
         static inline void activate(SIMDVector& vec)
         {
-            SIMDVector v=exp(vec);
-
-            vec=(v/(v+1))*vec;
+            vec=silu(vec);
         }
 
         template<size_t Size>
         static inline void activate(SIMDVectorLite<Size>& vec)
         {
-            SIMDVectorLite<Size> v=exp(vec);
-
-            vec=(v/(v+1))*vec;
+            vec=silu(vec);
         }
 
         static inline void inverse(SIMDVector& vec)
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "misc.hpp"
+
+namespace snn
+{
+    class Tanh
+    {
+        
+        public:
+
+        static inline void activate(SIMDVector& vec)
+        {
+            vec=tanh(vec);
+        }
+
+        template<size_t Size>
+        static inline void activate(SIMDVectorLite<Size>& vec)
+        {
+            vec=tanh(vec);
+        }
+
+        static inline void inverse(SIMDVector& vec)
+        {
+            
+        }
+    };
+}
\ No newline at end of file
@@ -13,12 +13,14 @@
 #include <cstdint>
 #include <filesystem>
 
-#include <thread>
-
 #include <openssl/sha.h>
 
 #include "layer.hpp"
 
+#include "thread_pool.hpp"
+
+#include "rng.hpp"
+
 namespace snn
 {
 
@@ -67,68 +69,38 @@ namespace snn
         }
 
         /*
-            Setup all layers in layer set of Arbiter.
+            Set global seed, random numbers of layers that weren't given their own
+            seed follow it. Call it before layers are created to make their
+            initial weights reproducible too.
         */
-        void setup()
+        void set_seed(uint64_t seed)
         {
-            for(std::shared_ptr<Layer> layer : this->layers)
-            {
-                layer->setup();
-            }
+            set_random_seed(seed);
         }
 
         /*
-            Static functions use for parallelization of shuttle functions. 
+            Setup all layers in layer set of Arbiter.
         */
-        static void concurrent_shuttle(const std::vector<std::shared_ptr<Layer>>& layers,size_t ptr,size_t& free_slot,std::mutex& mux)
+        void setup()
         {
-            while(ptr<layers.size())
+            for(std::shared_ptr<Layer> layer : this->layers)
             {
-                layers[ptr]->shuttle();
-
-                std::lock_guard _mux(mux);
-
-                ptr = free_slot;
-
-                free_slot++;
-
-                if(free_slot>=layers.size())
-                {
-                    return;
-                }
-
+                layer->setup();
             }
         }
 
         /*
 
             Perform layers evolution operation.
-        
+
         */
         void shuttle()
         {
-            std::thread workers[USED_THREADS];
-
-            size_t free_slot;
-
-            std::mutex _mux;
-
-            _mux.lock();
+            ThreadPool::global().parallel(this->layers.size(),[this](size_t i){
 
-            for(size_t i=0;i<USED_THREADS;++i)
-            {
-                workers[i] = std::thread(concurrent_shuttle,std::ref(this->layers),i,std::ref(free_slot),std::ref(_mux));
-            }
-
-            free_slot = USED_THREADS;
-
-            _mux.unlock();
-
-            for(auto& worker : workers)
-            {
-                worker.join();   
-            }
+                this->layers[i]->shuttle();
 
+            });
         }
 
         /*
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include <config.hpp>
+
+namespace snn
+{
+    /*!
+        A memory arena that hands out memory from a few large pages.
+
+        Memory given back with release() is kept in free lists, one per size in
+        cache lines, so it can be reused by later allocations. All pages are freed at
+        once in clear() or in destructor, objects placed in arena are not destroyed.
+    */
+    class Arena
+    {
+        struct FreeChunk
+        {
+            FreeChunk* next;
+        };
+
+        std::vector<void*> pages;
+
+        char* current;
+
+        size_t left;
+
+        size_t page_size;
+
+        FreeChunk* free_lists[ARENA_FREE_LIST_COUNT];
+
+        std::mutex mux;
+
+        static size_t round_size(size_t size)
+        {
+            return ( ( size + ARENA_LINE_SIZE - 1 )/ARENA_LINE_SIZE )*ARENA_LINE_SIZE;
+        }
+
+        void* new_page(size_t size)
+        {
+            void* page = ::operator new(size,std::align_val_t(ARENA_LINE_SIZE));
+
+            this->pages.push_back(page);
+
+            return page;
+        }
+
+        public:
+
+        Arena( size_t page_size = ARENA_PAGE_SIZE )
+        {
+            this->page_size = page_size;
+
+            this->current = nullptr;
+
+            this->left = 0;
+
+            for(FreeChunk*& list : this->free_lists)
+            {
+                list = nullptr;
+            }
+        }
+
+        Arena(const Arena&) = delete;
+
+        Arena& operator=(const Arena&) = delete;
+
+        /*!
+            Get memory of at least size bytes, aligned to alignment. Alignment up to
+            ARENA_LINE_SIZE is served from free lists.
+        */
+        void* allocate(size_t size,size_t alignment = ARENA_LINE_SIZE)
+        {
+            size = round_size(size);
+
+            std::lock_guard guard(this->mux);
+
+            const size_t lines = size/ARENA_LINE_SIZE;
+
+            if( alignment <= ARENA_LINE_SIZE && lines < ARENA_FREE_LIST_COUNT && this->free_lists[lines] )
+            {
+                FreeChunk* chunk = this->free_lists[lines];
+
+                this->free_lists[lines] = chunk->next;
+
+                return chunk;
+            }
+
+            // big allocations get thier own page
+            if( size + alignment > this->page_size )
+            {
+                return this->new_page(size);
+            }
+
+            size_t padding = ( alignment - reinterpret_cast<uintptr_t>(this->current) % alignment ) % alignment;
+
+            if( !this->current || size + padding > this->left )
+            {
+                this->current = static_cast<char*>(this->new_page(this->page_size));
+
+                this->left = this->page_size;
+
+                padding = 0;
+            }
+
+            void* ptr = this->current + padding;
+
+            this->current += size + padding;
+
+            this->left -= size + padding;
+
+            return ptr;
+        }
+
+        /*!
+            Get uninitialized memory for count objects of type T.
+        */
+        template<typename T>
+        T* allocate_array(size_t count)
+        {
+            return static_cast<T*>(this->allocate(count*sizeof(T),std::max<size_t>(alignof(T),ARENA_LINE_SIZE)));
+        }
+
+        /*!
+            Give memory of size bytes back to arena, so it can be reused.
+        */
+        void release(void* ptr,size_t size)
+        {
+            if( !ptr )
+            {
+                return;
+            }
+
+            const size_t lines = round_size(size)/ARENA_LINE_SIZE;
+
+            // chunks that doesn't fit in any list will be freed with thier page
+            if( lines >= ARENA_FREE_LIST_COUNT )
+            {
+                return;
+            }
+
+            std::lock_guard guard(this->mux);
+
+            FreeChunk* chunk = static_cast<FreeChunk*>(ptr);
+
+            chunk->next = this->free_lists[lines];
+
+            this->free_lists[lines] = chunk;
+        }
+
+        /*!
+            Free all pages at once.
+        */
+        void clear()
+        {
+            std::lock_guard guard(this->mux);
+
+            for(void* page : this->pages)
+            {
+                ::operator delete(page,std::align_val_t(ARENA_LINE_SIZE));
+            }
+
+            this->pages.clear();
+
+            this->current = nullptr;
+
+            this->left = 0;
+
+            for(FreeChunk*& list : this->free_lists)
+            {
+                list = nullptr;
+            }
+        }
+
+        size_t page_count() const
+        {
+            return this->pages.size();
+        }
+
+        ~Arena()
+        {
+            this->clear();
+        }
+
+    };
+
+}
@@ -6,7 +6,7 @@
 #include <memory>
 #include <random>
 #include <fstream>
-#include <algorithm>
+#include <numeric>
 
 #include "simd_vector.hpp"
 #include "simd_vector_lite.hpp"
@@ -18,6 +18,7 @@
 #include "misc.hpp"
 
 #include "initializers/hu.hpp"
+#include "rng.hpp"
 
 namespace snn
 {
@@ -42,35 +43,26 @@ namespace snn
 
         SIMDVectorLite<inputSize> worker;
 
-        std::mt19937 gen; 
-
         weight_initializer global;
 
-        std::uniform_real_distribution<float> uniform;
+        /*
+            Population of input i is row i of weights and rewards matrices, bias is
+            the last row. Rows are contiguous, so evolution of a row sweeps
+            Populus consecutive numbers instead of weight and reward pairs.
+        */
+        number weights[inputSize+1][Populus];
 
-        typedef struct weight
-        {
-            number weight;
-            number reward;
-        } weight_t;
+        number rewards[inputSize+1][Populus];
 
-        // there will be inputsize amount of block
-        typedef struct block
-        {
-            uint32_t id;
-            uint32_t swap_count;
-            // number rewards[Populus];
-            // number weights[Populus];
+        // index of current worker in each row
+        uint32_t ids[inputSize+1];
 
-            weight_t weights[Populus];
-        } block_t;
+        uint32_t swap_counts[inputSize+1];
 
         SIMDVectorLite<inputSize> best_weights;
 
         SIMDVectorLite<inputSize> curr_rewards;
 
-        block_t block[inputSize+1];
-
         // now since each sub block gets the same reward we will just them a pointer to it.
         long double reward;
 
@@ -88,12 +80,6 @@ namespace snn
 
             this->reward = 0.f;
 
-            std::random_device rd;
-
-            this->gen = std::mt19937(rd());
-
-            this->uniform = std::uniform_real_distribution<float>(0.f,1.f);
-
             this->worker = SIMDVectorLite<inputSize>(0);
 
             this->best_weights = SIMDVectorLite<inputSize>(0);
@@ -112,259 +98,149 @@ namespace snn
 
         void setup()
         {
-            // create file if not exits
-
-            // std::cout<<this->Id<<std::endl;
-
-            size_t i=0;
-
-            for(block_t& block : this->block)
+            for(size_t i=0;i<=inputSize;++i)
             {
-                block.id = static_cast<uint32_t>(std::round(this->uniform(this->gen)*(Populus-1)));
-                block.swap_count = 0;
-
+                this->ids[i] = static_cast<uint32_t>(std::round(random_uniform()*(Populus-1)));
+                this->swap_counts[i] = 0;
 
                 for(size_t w=0;w<Populus;w++)
                 {
-                    block.weights[w].weight = this->global.init();
-                    block.weights[w].reward = 0.f;
+                    this->weights[i][w] = this->global.init();
                 }
 
-                if( i!= inputSize )
-                {
-
-                    this->worker[i] = block.weights[block.id].weight;
-
-                }
-
-                ++i;
+                std::fill(this->rewards[i],this->rewards[i]+Populus,0.f);
             }
- 
+
+            this->gather_workers();
         }
 
-        number give_new_weight(block_t& victim)
+        /*!
+            Copy current weight of every input to worker, a single sweep over ids
+            instead of element writes into SIMD blocks.
+        */
+        void gather_workers()
         {
-            if( victim.collected_b_weight > 0 )
-            {
-                if( this->uniform(this->gen) >= 0.1f )
-                {
-                    return victim.best_weight_buffer / static_cast<number>(victim.collected_b_weight);
-                }
+            number gathered[inputSize];
 
-                return (victim.best_weight_buffer / static_cast<number>(victim.collected_b_weight)) + this->global.init();
+            for(size_t i=0;i<inputSize;++i)
+            {
+                gathered[i] = this->weights[i][this->ids[i]];
             }
 
-            return this->global.init();
-        }
-
-        static int compare_weights(const void *p1, const void *p2)
-        {
-            const weight_t *w1 = (const weight_t*)p1;
-            const weight_t *w2 = (const weight_t*)p2;
-
-            return w1->reward < w2->reward;
+            this->worker.copy_from(gathered);
         }
 
-
-        void chooseWorkers()
+        /*!
+            Keep the better half of row i, ordered by reward, put their weighted
+            average after them and fill the rest with its mutations. Only ranks of
+            the better half are needed, so indices are partially sorted and each
+            weight is moved once.
+        */
+        void evolve(size_t i)
         {
-            // if(this->Id==1)
-            // {
-            //     std::cout<<"Choose workers"<<std::endl;
-            // }
-            size_t iter=0;
-
-            if( this->reward >= 0 )
-            { 
-                return;
-            }
-
-
-
-            float switch_probability = std::min<float>(REWARD_TO_SWITCH_PROBABILITY*this->reward,MAX_SWITCH_PROBABILITY);
-
-            // size_t step = inputSize/(static_cast<size_t>(switch_probability*inputSize) + 1);
-
-            size_t step = static_cast<size_t>(1.0/switch_probability);
-
-            size_t start = std::min(step,inputSize-1);
+            number* row_weights = this->weights[i];
 
-            size_t i = static_cast<size_t>(std::round(this->uniform(this->gen)*start));
+            const number* row_rewards = this->rewards[i];
 
-            uint32_t block_step = static_cast<uint32_t>(std::round(this->uniform(this->gen)*Populus));
+            const size_t best_population_count = Populus/2;
 
+            uint32_t order[Populus];
 
-            block_t& bias = this->block[inputSize];
+            std::iota(order,order+Populus,0);
 
-            bias.weights[bias.id].reward = this->curr_rewards[i];
+            std::partial_sort(order,order+best_population_count,order+Populus,[row_rewards](uint32_t a,uint32_t b){ return row_rewards[a] > row_rewards[b]; });
 
-            bias.id += (block_step+i);
+            number best[Populus];
 
-            bias.id = bias.id % Populus;
+            // weight of rank w is 1/2^(w+1)
+            number best_weight = 0.f;
 
-            bias.swap_count++;
+            number exped = 0.5f;
 
+            number sum = 0.f;
 
-            for(;i<inputSize;i+=step)
+            for(size_t w=0;w<best_population_count;++w)
             {
+                best[w] = row_weights[order[w]];
 
+                best_weight += best[w]*exped;
 
-                block_t& _block = this->block[i];
-
-                _block.weights[_block.id].reward = this->curr_rewards[i];
-
-                _block.id += (block_step+i);
-
-                _block.id = _block.id % Populus;
-
-                if( i != inputSize )
-                {
-
-                    this->worker[i] = _block.weights[_block.id].weight;
-
-                    this->curr_rewards[i] = _block.weights[_block.id].reward;
-
-                }
-
-                _block.swap_count++;
-
+                sum += exped;
 
-                // sort weights based on thier rewards
-
-                if( _block.swap_count >= Populus*4 )
-                {
-                    
-                    qsort(_block.weights,Populus,sizeof(weight_t),compare_weights);
-
-                    // if( this->Id == 0 )
-                    // {
-                        
-                    //     std::cout<<"Block: "<<i<<_block.weights[0].reward<<", "<<_block.weights[1].reward<<", "<<_block.weights[2].reward<<std::endl;
-                    // }
-
-
-                    // calculate weighted average of the weights, first half of the best population
-
-                    number best_weight = 0;
+                exped *= 0.5f;
+            }
 
-                    const size_t best_population_count = Populus/2;
+            best_weight /= sum;
 
-                    const float best_population_discount = 1.f/(static_cast<float>(best_population_count));
+            std::copy(best,best+best_population_count,row_weights);
 
-                    number sum = 0;
+            row_weights[best_population_count] = best_weight;
 
-                    for(size_t w=0;w<best_population_count;++w)
-                    {
-                        number exped = 1/std::pow(2,w+1);
+            for(size_t w=best_population_count+1;w<Populus;++w)
+            {
+                row_weights[w] = best_weight + this->global.init();
+            }
 
-                        best_weight += ( _block.weights[w].weight * exped );
+            std::fill(this->rewards[i],this->rewards[i]+Populus,0.f);
 
-                        sum += exped;
+            this->swap_counts[i] = 0;
 
-                        _block.weights[w].reward = 0;
-                    }
+            this->ids[i] = best_population_count;
+        }
 
-                    best_weight /= sum;
+        void chooseWorkers()
+        {
+            if( this->reward >= 0 )
+            { 
+                return;
+            }
 
+            float switch_probability = std::min<float>(REWARD_TO_SWITCH_PROBABILITY*this->reward,MAX_SWITCH_PROBABILITY);
 
-                    _block.weights[best_population_count].weight = best_weight;
+            size_t step = static_cast<size_t>(1.0/switch_probability);
 
-                    _block.weights[best_population_count].reward = 0;
+            size_t start = std::min(step,inputSize-1);
 
+            size_t i = static_cast<size_t>(std::round(random_uniform()*start));
 
-                    for(size_t w=best_population_count+1;w<Populus;++w)
-                    {
+            uint32_t block_step = static_cast<uint32_t>(std::round(random_uniform()*Populus));
 
-                        number mutation = this->global.init();
+            // visited inputs are updated in plain array, written back at once
+            number current[inputSize];
 
-                        _block.weights[w].weight = best_weight+mutation;
+            this->curr_rewards.copy_to(current);
 
-                        _block.weights[w].reward = 0;
-                    }
+            // bias takes reward of the first visited input
+            this->rewards[inputSize][this->ids[inputSize]] = current[i];
 
-                    // if(this->Id == 1)
-                    // {
-                    //     std::cout<<"Sorted, first element reward: "<<_block.weights[0].reward<<std::endl;
-                    // }
+            this->ids[inputSize] = ( this->ids[inputSize] + block_step + i ) % Populus;
 
-                    _block.swap_count = 0;
+            this->swap_counts[inputSize]++;
 
-                    _block.id = best_population_count;
+            for(;i<inputSize;i+=step)
+            {
+                this->rewards[i][this->ids[i]] = current[i];
 
-                    if( i != inputSize )
-                    {
-                        this->worker[i] = _block.weights[_block.id].weight;
+                this->ids[i] = ( this->ids[i] + block_step + i ) % Populus;
 
-                        this->curr_rewards[i] = _block.weights[_block.id].reward;
-                    }
+                this->swap_counts[i]++;
 
+                if( this->swap_counts[i] >= Populus*4 )
+                {
+                    this->evolve(i);
                 }
 
-                iter++;
-
+                current[i] = this->rewards[i][this->ids[i]];
             }
 
-            if( bias.swap_count >= Populus*4 )
-                {
-                    
-                    qsort(bias.weights,Populus,sizeof(weight_t),compare_weights);
-
-                    // if( this->Id == 0 )
-                    // {
-                        
-                    //     std::cout<<"Block: "<<i<<_block.weights[0].reward<<", "<<_block.weights[1].reward<<", "<<_block.weights[2].reward<<std::endl;
-                    // }
-
-
-                    // calculate weighted average of the weights, first half of the best population
-
-                    number best_weight = 0;
-
-                    const size_t best_population_count = Populus/2;
-
-                    const float best_population_discount = 1.f/(static_cast<float>(best_population_count));
-
-                    number sum = 0;
-
-                    for(size_t w=0;w<best_population_count;++w)
-                    {
-                        number exped = 1/std::pow(2,w+1);
-
-                        best_weight += ( bias.weights[w].weight * exped );
-
-                        sum += exped;
-
-                        bias.weights[w].reward = 0;
-                    }
-
-                    best_weight /= sum;
-
-
-                    bias.weights[best_population_count].weight = best_weight;
-
-                    bias.weights[best_population_count].reward = 0;
-
-
-                    for(size_t w=best_population_count+1;w<Populus;++w)
-                    {
-
-                        number mutation = this->global.init();
-
-                        bias.weights[w].weight = best_weight+mutation;
-
-                        bias.weights[w].reward = 0;
-                    }
-
-                    // if(this->Id == 1)
-                    // {
-                    //     std::cout<<"Sorted, first element reward: "<<_block.weights[0].reward<<std::endl;
-                    // }
-
-                    bias.swap_count = 0;
+            if( this->swap_counts[inputSize] >= Populus*4 )
+            {
+                this->evolve(inputSize);
+            }
 
-                    bias.id = best_population_count;
+            this->curr_rewards.copy_from(current);
 
-                }
+            this->gather_workers();
 
             this->reward = 0;
         }
@@ -377,7 +253,7 @@ namespace snn
 
         number fire(const SIMDVectorLite<inputSize>& input)
         {
-            this->last_value = ( this->worker*input ).reduce() + this->block[inputSize].weights[this->block[inputSize].id].weight;
+            this->last_value = this->worker.dot(input) + this->weights[inputSize][this->ids[inputSize]];
             return this->last_value;// + this->bias;
         }
         
@@ -403,7 +279,14 @@ namespace snn
                 delete [] buff;
             }
 
-            out.write((char*)&this->block,sizeof(block_t)*inputSize);
+            // populations with bias row
+            out.write((const char*)this->ids,sizeof(this->ids));
+
+            out.write((const char*)this->swap_counts,sizeof(this->swap_counts));
+
+            out.write((const char*)this->weights,sizeof(this->weights));
+
+            out.write((const char*)this->rewards,sizeof(this->rewards));
 
         }
 
@@ -424,14 +307,25 @@ namespace snn
             }
 
 
-            // load blocks
+            // load populations
+            in.read((char*)this->ids,sizeof(this->ids));
+
+            in.read((char*)this->swap_counts,sizeof(this->swap_counts));
+
+            in.read((char*)this->weights,sizeof(this->weights));
+
+            in.read((char*)this->rewards,sizeof(this->rewards));
+
+            number current[inputSize];
+
             for(size_t i=0;i<inputSize;++i)
             {
-                in.read((char*)&this->block[i],sizeof(block_t));
+                current[i] = this->rewards[i][this->ids[i]];
+            }
+
+            this->curr_rewards.copy_from(current);
 
-                this->worker[i] = this->block[i].weights[this->block[i].id].weight;
-                this->curr_rewards[i] = this->block[i].weights[this->block[i].id].reward;
-            }   
+            this->gather_workers();
         }
         
     };
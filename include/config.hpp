@@ -24,6 +24,9 @@ typedef std::experimental::fixed_size_simd_mask<number , MAX_SIMD_VECTOR_SIZE> S
 
 #define MAX_THREAD_POOL 8
 
+// how many times ThreadPool::parallel yields, once all its tasks are taken, before it sleeps until they finish
+#define THREAD_POOL_WAIT_SPINS (64)
+
 #define SWARMING_SPEED_DEFAULT 10.f
 
 #define INITIAL_STD 0.1f
@@ -50,8 +53,49 @@ typedef std::experimental::fixed_size_simd_mask<number , MAX_SIMD_VECTOR_SIZE> S
 // we use gaussian distribution for initial values
 #define DEF_Y_INIT snn::GaussInit<(number)0.f,(number)0.001f>
 
+// alignment of spline node x and y arrays, one cache line
+#define SPLINE_NODE_ALIGNMENT (64)
+
+// type Spline and SplineStatic keep their nodes in, math is always done in number,
+// snn::half or snn::bfloat16 halve memory of nodes
+#define SPLINE_STORAGE number
+
+// SIMDVectorLite with more numbers than this keeps its blocks on heap, so big
+// vectors don't need big stacks and are moved without copying
+#define SIMD_VECTOR_HEAP_THRESHOLD (1024)
+
+// alignment of SIMDVectorLite blocks kept on heap
+#define SIMD_VECTOR_HEAP_ALIGNMENT (64)
+
+// size of a single page allocated by Arena
+#define ARENA_PAGE_SIZE (4*1024*1024)
+
+// Arena hands out memory in multiplies of that size
+#define ARENA_LINE_SIZE (64)
+
+// amount of Arena free lists, a list for each chunk size in lines
+#define ARENA_FREE_LIST_COUNT (64)
+
+// amount of outputs taken at once by EvoKanLayer workers, so they fill one cache line
+#define EVO_KAN_LAYER_CHUNK (ARENA_LINE_SIZE/sizeof(number))
 
-#define THREAD_COUNT (4)
+// amount of samples evaluated together for a single spline in batched fire
+#define EVO_KAN_BATCH_TILE (64)
+
+// how many active inputs ahead sparse fire prefetches splines
+#define EVO_KAN_SPARSE_PREFETCH (16)
+
+// amount of incremental fires after which cached sums of EvoKanLayer outputs are summed again from scratch
+#define EVO_KAN_INCREMENTAL_REFRESH (256)
+
+// default amount of knots shared by splines of one input in EvoKanLayerShared
+#define EVO_KAN_SHARED_KNOTS (32)
+
+// default amount of cells in compiled SplineGrid
+#define SPLINE_GRID_RESOLUTION (64)
+
+// default amount of cells in compiled SplineQuantized
+#define SPLINE_QUANTIZED_RESOLUTION (32)
 
 
 // A maximum weight switch probablity
@@ -62,6 +106,3 @@ typedef std::experimental::fixed_size_simd_mask<number , MAX_SIMD_VECTOR_SIZE> S
 
 // A rate at weights move to positive weight
 #define POSITIVE_P 0.1f
-
-
-#define USED_THREADS 4
\ No newline at end of file
@@ -1,32 +1,106 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 
 #include <simd_vector_lite.hpp>
 #include <misc.hpp>
 #include <evo_kan_spline.hpp>
+#include <evo_kan_spline_grid.hpp>
+#include <evo_kan_spline_quantized.hpp>
+#include <spline_kernel.hpp>
+#include <sparse_input.hpp>
+#include <arena.hpp>
 
 #include <config.hpp>
 
 namespace snn
 {
+    /*!
+        Versions of EvoKan blocks come from one process wide counter, so a version
+        names one state of splines and is never reused, even by a block made later
+        at the same address.
+    */
+    inline uint64_t next_block_version()
+    {
+        static std::atomic<uint64_t> versions(1);
+
+        return versions.fetch_add(1,std::memory_order_relaxed);
+    }
     
     template<size_t inputSize,class SplineClass = Spline>
     class EvoKan
     {
+        template<size_t,class>
+        friend class EvoKan;
+
         protected:
 
         SplineClass* splines;
 
-        SIMDVectorLite<inputSize> w;
+        // when set, splines are placed in arena and released together with it
+        Arena* arena;
+
+        // value of every spline at baseline_at, used by sparse fire
+        number* baseline_values;
+
+        number baseline;
+
+        number baseline_at;
+
+        // cleared whenever splines change
+        bool baseline_valid;
+
+        // new next_block_version() whenever splines change, lets cached spline values detect that they are stale
+        uint64_t version;
+
+        static number value(const SplineClass& spline,number x);
+
+        static void prefetch(const SplineClass& spline);
+
+        static void segment(const SplineClass& spline,number x,number& x_left,number& y_left,number& x_right,number& y_right);
+
+        static void segment(const SplineClass& spline,std::pair<size_t,size_t> nodes,number x,number& x_left,number& y_left,number& x_right,number& y_right);
 
         public:
 
-        EvoKan( size_t initial_size = 0 );
+        EvoKan( size_t initial_size = 8 , Arena* arena = nullptr );
+
+        void modified();
         
         void fit(const SIMDVectorLite<inputSize>& input,number output,number target);
 
-        number fire(const SIMDVectorLite<inputSize>& input);
+        static size_t select(size_t count,const number* outputs,const number* targets,size_t* active,number* tar);
+
+        void fit_input(size_t input,const number* column,const size_t* active,const number* tar,size_t picked);
+
+        void fit_batch(const number* columns,size_t count,const number* outputs,const number* targets);
+
+        number fire_and_fit(const SIMDVectorLite<inputSize>& input,number target);
+
+        number fire(const SIMDVectorLite<inputSize>& input) const;
+
+        void fire_input(size_t input,const number* column,size_t count,number* outputs) const;
+
+        void fire(const number* columns,size_t count,number* outputs) const;
+
+        void set_background(number background);
+
+        number fire(const SparseInput<inputSize>& input) const;
+
+        number fire_terms(const number* x,number* terms) const;
+
+        number update_term(size_t input,number x,number* terms) const;
+
+        uint64_t get_version() const
+        {
+            return this->version;
+        }
+
+        void copy_from(const EvoKan& block);
+
+        template<class SourceSpline>
+        number compile(const EvoKan<inputSize,SourceSpline>& source);
 
         void simplify();
 
@@ -42,9 +116,153 @@ namespace snn
 
 
     template<size_t inputSize,class SplineClass>
-    EvoKan<inputSize,SplineClass>::EvoKan( size_t initial_size )
+    EvoKan<inputSize,SplineClass>::EvoKan( size_t initial_size , Arena* arena )
     {
-        this->splines = new SplineClass[inputSize](initial_size);
+        this->arena = arena;
+
+        if( this->arena )
+        {
+            this->splines = this->arena->template allocate_array<SplineClass>(inputSize);
+
+            this->baseline_values = this->arena->template allocate_array<number>(inputSize);
+        }
+        else
+        {
+            this->splines = static_cast<SplineClass*>(::operator new(sizeof(SplineClass)*inputSize,std::align_val_t(alignof(SplineClass))));
+
+            this->baseline_values = new number[inputSize];
+        }
+
+        this->baseline = 0.f;
+
+        this->baseline_at = 0.f;
+
+        this->baseline_valid = false;
+
+        this->version = next_block_version();
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            new (&this->splines[i]) SplineClass(initial_size,this->arena);
+        }
+    }
+
+    /*!
+        Called after any change of splines, drops caches built from old values.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::modified()
+    {
+        this->baseline_valid = false;
+
+        this->version = next_block_version();
+    }
+
+    /*!
+        Find nodes of spline segment that contains x. Missing nodes are replaced, so that
+        ( y_right - y_left )/( x_right - x_left )*( x - x_left ) + y_left gives spline value.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::segment(const SplineClass& spline,number x,number& x_left,number& y_left,number& x_right,number& y_right)
+    {
+        EvoKan::segment(spline,spline.search(x),x,x_left,y_left,x_right,y_right);
+    }
+
+    /*!
+        Same as above, for nodes already found with search.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::segment(const SplineClass& spline,std::pair<size_t,size_t> nodes,number x,number& x_left,number& y_left,number& x_right,number& y_right)
+    {
+        const auto* nodes_x = spline.get_x();
+        const auto* nodes_y = spline.get_y();
+
+        const size_t left = nodes.first;
+        const size_t right = nodes.second;
+
+        y_left = 0.f;
+
+        x_left = 0.f;
+        x_right = 1.f;
+
+        if( left == SPLINE_NO_NODE && right == SPLINE_NO_NODE )
+        {
+            y_right = 0.f;
+
+            return;
+        }
+
+        if( left != SPLINE_NO_NODE && right == SPLINE_NO_NODE )
+        {
+            y_right = nodes_x[left] == x ? static_cast<number>(nodes_y[left]) : 0;
+
+            return;
+        }
+
+        if( left == SPLINE_NO_NODE && right != SPLINE_NO_NODE )
+        {
+            y_right = nodes_x[right] == x ? static_cast<number>(nodes_y[right]) : 0;
+
+            return;
+        }
+
+        if( left == right )
+        {
+            y_right = nodes_y[left];
+
+            return;
+        }
+
+        // when both nodes are valid
+
+        x_left = nodes_x[left];
+        y_left = nodes_y[left];
+
+        x_right = nodes_x[right];
+        y_right = nodes_y[right];
+    }
+
+    /*!
+        Value of a single spline at x, computed the same way as in fire.
+    */
+    template<size_t inputSize,class SplineClass>
+    number EvoKan<inputSize,SplineClass>::value(const SplineClass& spline,number x)
+    {
+        if constexpr ( SplineClass::read_only )
+        {
+            return spline.fire(x);
+        }
+        else
+        {
+            number x_left;
+            number y_left;
+            number x_right;
+            number y_right;
+
+            EvoKan::segment(spline,x,x_left,y_left,x_right,y_right);
+
+            return ( y_right - y_left )/( x_right - x_left )*( x - x_left ) + y_left;
+        }
+    }
+
+    /*!
+        Ask for spline and its nodes to be loaded into cache.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::prefetch(const SplineClass& spline)
+    {
+        const char* begin = reinterpret_cast<const char*>(&spline);
+
+        for(size_t offset=0;offset<sizeof(SplineClass);offset+=ARENA_LINE_SIZE)
+        {
+            __builtin_prefetch(begin + offset);
+        }
+
+        if constexpr ( !SplineClass::read_only )
+        {
+            __builtin_prefetch(spline.get_x());
+            __builtin_prefetch(spline.get_y());
+        }
     }
 
     /*!
@@ -69,94 +287,413 @@ namespace snn
             this->splines[i].fit(input[i],tar);
         }
 
+        this->modified();
+
     }
 
     /*!
-        Use splines to return activation for input. It use SIMD parralization to speed up a process.
+        Fire and fit in one step. Every spline is searched once, found segments are
+        kept and reused by fit, so nodes are read while they are still in cache.
+        Update is skipped when output is already close enough to target.
+
+        Returns output from before the update.
     */
     template<size_t inputSize,class SplineClass>
-    number EvoKan<inputSize,SplineClass>::fire(const SIMDVectorLite<inputSize>& input)
+    number EvoKan<inputSize,SplineClass>::fire_and_fit(const SIMDVectorLite<inputSize>& input,number target)
     {
+        if constexpr ( SplineClass::read_only )
+        {
+            return this->fire(input);
+        }
+        else
+        {
+            alignas(SPLINE_NODE_ALIGNMENT) number x[inputSize];
 
-        SIMDVectorLite<inputSize> x_left;
-        SIMDVectorLite<inputSize> y_left;
+            input.copy_to(x);
 
-        SIMDVectorLite<inputSize> x_right;
-        SIMDVectorLite<inputSize> y_right;
+            std::pair<size_t,size_t> nodes[inputSize];
 
-        SIMDVectorLite<inputSize> a;
+            number output = 0.f;
 
-        for(size_t i=0;i<inputSize;++i)
-        {
-            number _x = input[i];
+            for(size_t i=0;i<inputSize;++i)
+            {
+                nodes[i] = this->splines[i].search(x[i]);
+
+                number x_left;
+                number y_left;
+                number x_right;
+                number y_right;
 
-            std::pair<SplineNode*,SplineNode*> nodes = this->splines[i].search(_x);
+                EvoKan::segment(this->splines[i],nodes[i],x[i],x_left,y_left,x_right,y_right);
 
-            // when both nodes are valid
+                output += ( y_right - y_left )/( x_right - x_left )*( x[i] - x_left ) + y_left;
+            }
+
+            if( abs(target - output) < ERROR_THRESHOLD_FOR_FIT )
+            {
+                return output;
+            }
 
-            SplineNode* left = nodes.first;
-            SplineNode* right = nodes.second;
+            const number tar = target/static_cast<number>(inputSize);
 
-            if( !left && !right)
+            for(size_t i=0;i<inputSize;++i)
             {
-                y_left[i] = 0.f;
-                y_right[i] = 0.f;
+                this->splines[i].fit(x[i],tar,nodes[i]);
+            }
+
+            this->modified();
+
+            return output;
+        }
+    }
 
-                x_left[i] = 0.f;
-                x_right[i] = 1.f;
+    /*!
+        Pick samples of a batch that need fitting, those close enough to thier target
+        are skipped. Returns amount of picked samples, thier ids go to active and
+        targets divided between splines go to tar.
+    */
+    template<size_t inputSize,class SplineClass>
+    size_t EvoKan<inputSize,SplineClass>::select(size_t count,const number* outputs,const number* targets,size_t* active,number* tar)
+    {
+        size_t picked = 0;
 
+        for(size_t s=0;s<count;++s)
+        {
+            if( abs(targets[s] - outputs[s]) < ERROR_THRESHOLD_FOR_FIT )
+            {
                 continue;
             }
 
-            if( left && !right )
+            active[picked] = s;
+
+            tar[picked] = targets[s]/static_cast<number>(inputSize);
+
+            picked++;
+        }
+
+        return picked;
+    }
+
+    /*!
+        Fit spline of given input with picked samples of a batch, column holds value of
+        that input for every sample in batch. Only the baseline is dropped here, call
+        modified() once after the last input so the block gets a single new version.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::fit_input(size_t input,const number* column,const size_t* active,const number* tar,size_t picked)
+    {
+        static thread_local std::vector<number> x;
+
+        x.resize(picked);
+
+        for(size_t a=0;a<picked;++a)
+        {
+            x[a] = column[active[a]];
+        }
+
+        this->splines[input].fit_batch(x.data(),tar,picked);
+
+        this->baseline_valid = false;
+    }
+
+    /*!
+        Fit for a batch of count samples, columns are laid out like in batched fire.
+        Each spline gets nudges from all picked samples and updates its nodes once.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::fit_batch(const number* columns,size_t count,const number* outputs,const number* targets)
+    {
+        std::vector<size_t> active(count);
+
+        std::vector<number> tar(count);
+
+        const size_t picked = EvoKan::select(count,outputs,targets,active.data(),tar.data());
+
+        if( picked == 0 )
+        {
+            return;
+        }
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            this->fit_input(i,columns + i*count,active.data(),tar.data(),picked);
+        }
+
+        this->modified();
+    }
+
+    /*!
+        Use splines to return activation for input. It use SIMD parralization to speed up a process.
+
+        It doesn't modify block, all scratch data is kept on caller stack, so many
+        threads can fire one block at once.
+    */
+    template<size_t inputSize,class SplineClass>
+    number EvoKan<inputSize,SplineClass>::fire(const SIMDVectorLite<inputSize>& input) const
+    {
+
+        // splines with fixed layout are evaluated by SIMD kernel
+        if constexpr ( SplineKernel<SplineClass>::available )
+        {
+            alignas(SPLINE_NODE_ALIGNMENT) number x[inputSize];
+
+            input.copy_to(x);
+
+            return SplineKernel<SplineClass>::fire(this->splines,x,inputSize);
+        }
+        // read-only splines evaluate without search
+        else if constexpr ( SplineClass::read_only )
+        {
+            number sum = 0.f;
+
+            for(size_t i=0;i<inputSize;++i)
             {
-                y_left[i] = 0.f;
-                y_right[i] = left->x == input[i] ? left->y : 0;
+                sum += this->splines[i].fire(input[i]);
+            }
 
-                x_left[i] = 0.f;
-                x_right[i] = 1.f;
+            return sum;
+        }
+        else
+        {
+            SIMDVectorLite<inputSize> x_left;
+            SIMDVectorLite<inputSize> y_left;
 
-                continue;
+            SIMDVectorLite<inputSize> x_right;
+            SIMDVectorLite<inputSize> y_right;
+
+            for(size_t i=0;i<inputSize;++i)
+            {
+                number _x_left;
+                number _y_left;
+                number _x_right;
+                number _y_right;
+
+                EvoKan::segment(this->splines[i],input[i],_x_left,_y_left,_x_right,_y_right);
+
+                x_left[i] = _x_left;
+                y_left[i] = _y_left;
+
+                x_right[i] = _x_right;
+                y_right[i] = _y_right;
+            }
+
+            return ( ( y_right - y_left )/( x_right - x_left )*( input - x_left ) + y_left ).reduce();
+        }
+    }
+
+    /*!
+        Add values of spline input for a batch of count samples to outputs, column holds
+        value of that input for every sample. Segments are searched in tiles of
+        EVO_KAN_BATCH_TILE samples, so arithmetic runs as one vectorized loop.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::fire_input(size_t input,const number* column,size_t count,number* outputs) const
+    {
+        const SplineClass& spline = this->splines[input];
+
+        if constexpr ( SplineKernel<SplineClass>::available )
+        {
+            SplineKernel<SplineClass>::fire_column(spline,column,count,outputs);
+        }
+        else if constexpr ( SplineClass::read_only )
+        {
+            for(size_t s=0;s<count;++s)
+            {
+                outputs[s] += spline.fire(column[s]);
             }
+        }
+        else
+        {
+            number x_left[EVO_KAN_BATCH_TILE];
+            number y_left[EVO_KAN_BATCH_TILE];
+
+            number x_right[EVO_KAN_BATCH_TILE];
+            number y_right[EVO_KAN_BATCH_TILE];
 
-            if( !left && right )
+            for(size_t tile=0;tile<count;tile+=EVO_KAN_BATCH_TILE)
             {
-                y_left[i] = 0.f;
-                y_right[i] = right->x == input[i] ? right->y : 0;
+                const size_t tile_size = std::min<size_t>(EVO_KAN_BATCH_TILE,count - tile);
 
-                x_left[i] = 0.f;
-                x_right[i] = 1.f;
+                for(size_t s=0;s<tile_size;++s)
+                {
+                    EvoKan::segment(spline,column[tile+s],x_left[s],y_left[s],x_right[s],y_right[s]);
+                }
 
-                continue;
+                for(size_t s=0;s<tile_size;++s)
+                {
+                    outputs[tile+s] += ( y_right[s] - y_left[s] )/( x_right[s] - x_left[s] )*( column[tile+s] - x_left[s] ) + y_left[s];
+                }
             }
+        }
+    }
+
+    /*!
+        Fire for a batch of count samples. Columns holds inputs input-major, value of input
+        i for sample s is at columns[i*count + s]. Splines are walked in outer loop, so
+        nodes of each spline are read once for the whole batch.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::fire(const number* columns,size_t count,number* outputs) const
+    {
+        for(size_t s=0;s<count;++s)
+        {
+            outputs[s] = 0.f;
+        }
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            this->fire_input(i,columns + i*count,count,outputs);
+        }
+    }
+
+    /*!
+        Cache value of every spline at background value, so sparse fire only has to
+        look at inputs that differ from background. Cache is dropped when splines change.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::set_background(number background)
+    {
+        this->baseline = 0.f;
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            this->baseline_values[i] = EvoKan::value(this->splines[i],background);
+
+            this->baseline += this->baseline_values[i];
+        }
+
+        this->baseline_at = background;
+
+        this->baseline_valid = true;
+    }
+
+    /*!
+        Fire for input where most of values are equal to its background. With cache
+        from set_background only active inputs are evaluated, without it background
+        value of every spline is computed on the fly.
+    */
+    template<size_t inputSize,class SplineClass>
+    number EvoKan<inputSize,SplineClass>::fire(const SparseInput<inputSize>& input) const
+    {
+        const uint32_t* indexes = input.get_indexes();
+
+        const number* values = input.get_values();
+
+        const size_t length = input.length();
+
+        const number background = input.get_background();
 
-            if( left == right )
+        number output = 0.f;
+
+        if( this->baseline_valid && this->baseline_at == background )
+        {
+            output = this->baseline;
+
+            for(size_t a=0;a<length;++a)
             {
+                const size_t i = indexes[a];
 
-                y_left[i] = 0.f;
-                y_right[i] = left->y;
+                // active inputs are scattered, so hardware prefetcher doesn't follow them
+                if( a + EVO_KAN_SPARSE_PREFETCH < length )
+                {
+                    EvoKan::prefetch(this->splines[indexes[a + EVO_KAN_SPARSE_PREFETCH]]);
+                }
 
-                x_left[i] = 0.f;
-                x_right[i] = 1.f;
+                output += EvoKan::value(this->splines[i],values[a]) - this->baseline_values[i];
+            }
 
-                continue;
+            return output;
+        }
+
+        size_t a = 0;
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            if( a < length && indexes[a] == i )
+            {
+                output += EvoKan::value(this->splines[i],values[a]);
+
+                a++;
             }
+            else
+            {
+                output += EvoKan::value(this->splines[i],background);
+            }
+        }
+
+        return output;
+    }
+
+    /*!
+        Fire for input x given as plain array, value of every spline goes to terms.
+        Returns sum of terms.
+    */
+    template<size_t inputSize,class SplineClass>
+    number EvoKan<inputSize,SplineClass>::fire_terms(const number* x,number* terms) const
+    {
+        number sum = 0.f;
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            terms[i] = EvoKan::value(this->splines[i],x[i]);
+
+            sum += terms[i];
+        }
+
+        return sum;
+    }
+
+    /*!
+        Recompute value of spline input at x, terms holds values from fire_terms.
+        Returns how much output changed.
+    */
+    template<size_t inputSize,class SplineClass>
+    number EvoKan<inputSize,SplineClass>::update_term(size_t input,number x,number* terms) const
+    {
+        const number term = EvoKan::value(this->splines[input],x);
 
-            x_left[i] = left->x;
-            y_left[i] = left->y;
+        const number delta = term - terms[input];
 
-            x_right[i] = right->x;
-            y_right[i] = right->y;
+        terms[input] = term;
 
+        return delta;
+    }
+
+    /*!
+        Copy parameters of all splines from other block.
+    */
+    template<size_t inputSize,class SplineClass>
+    void EvoKan<inputSize,SplineClass>::copy_from(const EvoKan& block)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            this->splines[i] = block.splines[i];
         }
 
-        SIMDVectorLite<inputSize> x = input - x_left;
+        this->modified();
 
-        a = ( y_right - y_left )/(x_right - x_left);
+        // splines are the same as in block, so values cached for it stay valid
+        this->version = block.version;
+    }
 
-        this->w = a*x + y_left;
+    /*!
+        Resample splines of source block into this one, used with read-only splines
+        like SplineGrid. Returns maximal approximation error of all splines.
+    */
+    template<size_t inputSize,class SplineClass>
+    template<class SourceSpline>
+    number EvoKan<inputSize,SplineClass>::compile(const EvoKan<inputSize,SourceSpline>& source)
+    {
+        number error = 0.f;
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            error = std::max<number>(error,this->splines[i].compile(source.splines[i]));
+        }
+
+        this->modified();
 
-        return w.reduce();
+        return error;
     }
 
     template<size_t inputSize,class SplineClass>
@@ -166,6 +703,8 @@ namespace snn
         {
             this->splines[i].simplify();
         }
+
+        this->modified();
     }
 
     template<size_t inputSize,class SplineClass>
@@ -197,12 +736,27 @@ namespace snn
         {
             this->splines[i].load(in);
         }
+
+        this->modified();
     }
 
     template<size_t inputSize,class SplineClass>
     EvoKan<inputSize,SplineClass>::~EvoKan()
     {
-        delete [] this->splines;
+        // arena releases splines memory all at once
+        if( this->arena )
+        {
+            return;
+        }
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            this->splines[i].~SplineClass();
+        }
+
+        ::operator delete(this->splines,std::align_val_t(alignof(SplineClass)));
+
+        delete [] this->baseline_values;
     }
 
 } // namespace snn
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <config.hpp>
+
+namespace snn
+{
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    class EvoKanLayer;
+
+    /*!
+        State of incremental fire of EvoKanLayer, for inputs that change only a bit
+        between calls, like consecutive frames of a control loop.
+
+        It remembers last input, value of every spline and sum of each output. Next
+        fire recomputes only splines whose input moved by more than tolerance, and
+        whole blocks that were changed by fit since. Running sums are summed again
+        from cached values every refresh_interval fires, so rounding errors don't
+        pile up.
+
+        State belongs to caller, one state follows one stream of inputs. Cached values
+        of a block are checked against its version, which is unique in process, so
+        state can be moved to other layer and reuses values only of blocks that hold
+        the same splines, e.g. both copies of EvoKanLayerOnline after publish().
+    */
+    template< size_t inputSize, size_t outputSize >
+    class EvoKanIncremental
+    {
+        template<size_t,size_t,class>
+        friend class EvoKanLayer;
+
+        protected:
+
+        // input that cached values were computed for
+        number* input;
+
+        // value of spline i of block id is at terms[id*inputSize + i]
+        number* terms;
+
+        number* sums;
+
+        // versions of blocks at time thier terms were computed
+        uint64_t* versions;
+
+        // indexes of inputs that moved in current fire
+        std::vector<uint32_t> changed;
+
+        // set once input, terms and sums hold values of some fire
+        bool filled;
+
+        size_t frames;
+
+        size_t refresh_interval;
+
+        number tolerance;
+
+        public:
+
+        EvoKanIncremental( number tolerance = 0.f , size_t refresh_interval = EVO_KAN_INCREMENTAL_REFRESH )
+        {
+            this->input = new number[inputSize];
+
+            this->terms = new number[inputSize*outputSize];
+
+            this->sums = new number[outputSize];
+
+            this->versions = new uint64_t[outputSize];
+
+            this->changed.reserve(inputSize);
+
+            this->tolerance = tolerance;
+
+            this->refresh_interval = refresh_interval;
+
+            this->reset();
+        }
+
+        EvoKanIncremental(const EvoKanIncremental&) = delete;
+
+        EvoKanIncremental& operator=(const EvoKanIncremental&) = delete;
+
+        /*!
+            Forget cached values, next fire computes everything.
+        */
+        void reset()
+        {
+            this->filled = false;
+
+            this->frames = 0;
+        }
+
+        /*!
+            Amount of inputs recomputed in last fire.
+        */
+        size_t last_changed() const
+        {
+            return this->changed.size();
+        }
+
+        ~EvoKanIncremental()
+        {
+            delete [] this->input;
+
+            delete [] this->terms;
+
+            delete [] this->sums;
+
+            delete [] this->versions;
+        }
+
+    };
+
+}
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <vector>
-#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include <evo_kan_block.hpp>
+#include <evo_kan_incremental.hpp>
+#include <arena.hpp>
+#include <thread_pool.hpp>
+#include <rng.hpp>
 
 #include <simd_vector_lite.hpp>
 #include <config.hpp>
@@ -15,25 +20,56 @@ namespace snn
     template< size_t inputSize, size_t outputSize,class SplineClass = Spline >
     class EvoKanLayer
     {
+        template<size_t,size_t,class>
+        friend class EvoKanLayer;
+
         protected:
 
+        // owns memory of all blocks, splines and nodes, has to be created before them
+        Arena arena;
+
         EvoKan<inputSize,SplineClass> *blocks;
 
-        SIMDVectorLite<outputSize> output;
+        static constexpr size_t chunk_count = ( outputSize + EVO_KAN_LAYER_CHUNK - 1 )/EVO_KAN_LAYER_CHUNK;
+
+        static void transpose(const SIMDVectorLite<inputSize>* inputs,size_t count,std::vector<number>& columns);
 
+        template<class Input>
+        static void fire_thread(const EvoKan<inputSize,SplineClass> *blocks,const Input& input,number* output,std::atomic<size_t>& current_id);
 
-        static void fire_thread(EvoKan<inputSize,SplineClass> *blocks,const SIMDVectorLite<inputSize>&input,SIMDVectorLite<outputSize>& output,size_t& current_id,std::mutex& mux);
+        static void fit_thread(EvoKan<inputSize,SplineClass> *blocks,const SIMDVectorLite<inputSize>&input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target,std::atomic<size_t>& current_id);
 
-        static void fit_thread(EvoKan<inputSize,SplineClass> *blocks,const SIMDVectorLite<inputSize>&input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target,size_t& current_id,std::mutex& mux);
+        void create_blocks(size_t initial_spline_size,uint64_t seed,uint64_t layer);
 
         public:
 
-        EvoKanLayer( size_t initial_spline_size = 0);
+        EvoKanLayer( size_t initial_spline_size = 8 );
+
+        EvoKanLayer( size_t initial_spline_size, uint64_t seed, uint64_t layer = 0 );
+
+        SIMDVectorLite<outputSize> fire(const SIMDVectorLite<inputSize>& input) const;
+
+        void fire(const SIMDVectorLite<inputSize>* inputs,size_t count,SIMDVectorLite<outputSize>* outputs) const;
 
-        SIMDVectorLite<outputSize> fire(const SIMDVectorLite<inputSize>& input);
+        SIMDVectorLite<outputSize> fire(const SparseInput<inputSize>& input) const;
+
+        SIMDVectorLite<outputSize> fire(const SIMDVectorLite<inputSize>& input,EvoKanIncremental<inputSize,outputSize>& state) const;
+
+        void set_background(number background);
+
+        void fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target);
 
         void fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target);
 
+        void fit_batch(const SIMDVectorLite<inputSize>* inputs,const SIMDVectorLite<outputSize>* targets,size_t count);
+
+        SIMDVectorLite<outputSize> fire_and_fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target);
+
+        void copy_from(const EvoKanLayer& layer);
+
+        template<class SourceSpline>
+        number compile(const EvoKanLayer<inputSize,outputSize,SourceSpline>& source);
+
         void save(std::ostream& out) const;
 
         void load(std::istream& in);
@@ -43,114 +79,529 @@ namespace snn
     }; 
 
 
+    /*!
+        Lay out inputs input-major, value of input i for sample s goes to columns[i*count + s].
+    */
     template< size_t inputSize, size_t outputSize,class SplineClass >
-    void EvoKanLayer<inputSize,outputSize,SplineClass>::fire_thread(EvoKan<inputSize,SplineClass> *blocks,const SIMDVectorLite<inputSize>&input,SIMDVectorLite<outputSize>& output,size_t& current_id,std::mutex& mux)
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::transpose(const SIMDVectorLite<inputSize>* inputs,size_t count,std::vector<number>& columns)
     {
-        size_t id = 0;
+        columns.resize(inputSize*count);
 
+        for( size_t s=0; s<count; ++s )
+        {
+            for( size_t i=0; i<inputSize; ++i )
+            {
+                columns[i*count + s] = inputs[s][i];
+            }
+        }
+    }
+
+    /*!
+        Workers take chunks of EVO_KAN_LAYER_CHUNK outputs from shared atomic counter.
+        Input is either dense SIMDVectorLite or SparseInput.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    template<class Input>
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::fire_thread(const EvoKan<inputSize,SplineClass> *blocks,const Input& input,number* output,std::atomic<size_t>& current_id)
+    {
         while( true )
         {
+            const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
+
+            if( start >= outputSize )
             {
-                std::lock_guard guard(mux);
+                return;
+            }
+
+            const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
+
+            for(size_t id=start;id<end;++id)
+            {
+                output[id] = blocks[id].fire(input);
+            }
+        }
+    }
+
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::fit_thread(EvoKan<inputSize,SplineClass> *blocks,const SIMDVectorLite<inputSize>&input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target,std::atomic<size_t>& current_id)
+    {
+        while( true )
+        {
+            const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
 
-                id = current_id;
+            if( start >= outputSize )
+            {
+                return;
+            }
 
-                current_id++;
+            const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
 
-                if( id >= outputSize )
-                {
-                    return;
-                }
+            for(size_t id=start;id<end;++id)
+            {
+                blocks[id].fit(input,output[id],target[id]);
             }
+        }
+    }
+
+    /*!
+        Initial splines of block i are drawn from RandomScope keyed by (seed, layer, i, 0).
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::create_blocks(size_t initial_spline_size,uint64_t seed,uint64_t layer)
+    {
+        this->blocks = this->arena.template allocate_array<EvoKan<inputSize,SplineClass>>(outputSize);
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            RandomScope scope(seed,layer,i,0);
 
-            output[id] = blocks[id].fire(input);
+            new (&this->blocks[i]) EvoKan<inputSize,SplineClass>(initial_spline_size,&this->arena);
         }
     }
 
+    /*!
+        Weights follow global seed and order of construction, layer is next_random_layer,
+        so layers created in the same order after set_random_seed get the same weights.
+    */
     template< size_t inputSize, size_t outputSize,class SplineClass >
-    void EvoKanLayer<inputSize,outputSize,SplineClass>::fit_thread(EvoKan<inputSize,SplineClass> *blocks,const SIMDVectorLite<inputSize>&input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target,size_t& current_id,std::mutex& mux)
+    EvoKanLayer<inputSize,outputSize,SplineClass>::EvoKanLayer( size_t initial_spline_size)
     {
-        size_t id = 0;
+        this->create_blocks(initial_spline_size,random_seed(),next_random_layer());
+    }
 
-        number _target;
-        number _output;
+    /*!
+        Weights depend only on seed and layer, layers built from the same pair are equal
+        no matter what was created before them. Give different layer ids to layers of
+        one model that share a seed.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    EvoKanLayer<inputSize,outputSize,SplineClass>::EvoKanLayer( size_t initial_spline_size, uint64_t seed, uint64_t layer )
+    {
+        this->create_blocks(initial_spline_size,seed,layer);
+    }
 
-        while( true )
+    /*!
+        Layer isn't modified, outputs are gathered on caller stack, so one layer can
+        serve many inference threads at once without locks.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    SIMDVectorLite<outputSize> EvoKanLayer<inputSize,outputSize,SplineClass>::fire(const SIMDVectorLite<inputSize>& input) const
+    {
+        // workers write here, each chunk of outputs fills its own cache line
+        alignas(ARENA_LINE_SIZE) number output_slots[outputSize];
+
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            EvoKanLayer::fire_thread(this->blocks,input,output_slots,current_id);
+
+        });
+
+        SIMDVectorLite<outputSize> output;
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            output[i] = output_slots[i];
+        }
+
+        return output;
+
+    }
+
+    /*!
+        Fire for sparse input. Call set_background after training, so blocks evaluate
+        only inputs that differ from background.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    SIMDVectorLite<outputSize> EvoKanLayer<inputSize,outputSize,SplineClass>::fire(const SparseInput<inputSize>& input) const
+    {
+        alignas(ARENA_LINE_SIZE) number output_slots[outputSize];
+
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            EvoKanLayer::fire_thread(this->blocks,input,output_slots,current_id);
+
+        });
+
+        SIMDVectorLite<outputSize> output;
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            output[i] = output_slots[i];
+        }
+
+        return output;
+    }
+
+    /*!
+        Incremental fire, for inputs that change only slightly between calls. Only
+        splines whose input moved since last call with the same state are evaluated,
+        blocks changed by fit are computed again as a whole.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    SIMDVectorLite<outputSize> EvoKanLayer<inputSize,outputSize,SplineClass>::fire(const SIMDVectorLite<inputSize>& input,EvoKanIncremental<inputSize,outputSize>& state) const
+    {
+        alignas(SPLINE_NODE_ALIGNMENT) number x[inputSize];
+
+        input.copy_to(x);
+
+        // nothing cached yet, every block is computed from scratch
+        const bool full = !state.filled;
+
+        state.changed.clear();
+
+        for( size_t i=0; i<inputSize; ++i )
         {
+            if( full || abs( x[i] - state.input[i] ) > state.tolerance )
             {
-                std::lock_guard guard(mux);
+                state.changed.push_back(i);
+
+                state.input[i] = x[i];
+            }
+        }
+
+        state.frames++;
 
-                id = current_id;
+        const bool refresh = state.frames >= state.refresh_interval;
 
-                current_id++;
+        if( refresh )
+        {
+            state.frames = 0;
+        }
+
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            while( true )
+            {
+                const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
 
-                if( id >= outputSize )
+                if( start >= outputSize )
                 {
                     return;
                 }
 
-                _target = target[id];
-                _output = output[id];
+                const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
+
+                for( size_t id=start; id<end; ++id )
+                {
+                    number* terms = state.terms + id*inputSize;
+
+                    // values kept in state are evaluated at state.input, not at x
+                    if( full || state.versions[id] != this->blocks[id].get_version() )
+                    {
+                        state.sums[id] = this->blocks[id].fire_terms(state.input,terms);
+
+                        state.versions[id] = this->blocks[id].get_version();
+
+                        continue;
+                    }
+
+                    number sum = state.sums[id];
+
+                    for( const uint32_t i : state.changed )
+                    {
+                        sum += this->blocks[id].update_term(i,state.input[i],terms);
+                    }
+
+                    if( refresh )
+                    {
+                        sum = 0.f;
+
+                        for( size_t i=0; i<inputSize; ++i )
+                        {
+                            sum += terms[i];
+                        }
+                    }
+
+                    state.sums[id] = sum;
+                }
             }
 
-            blocks[id].fit(input,_output,_target);
+        });
+
+        state.filled = true;
+
+        SIMDVectorLite<outputSize> output;
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            output[i] = state.sums[i];
         }
+
+        return output;
     }
 
+    /*!
+        Cache values of all splines at background value of sparse inputs.
+    */
     template< size_t inputSize, size_t outputSize,class SplineClass >
-    EvoKanLayer<inputSize,outputSize,SplineClass>::EvoKanLayer( size_t initial_spline_size)
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::set_background(number background)
     {
-        this->blocks = new EvoKan<inputSize,SplineClass>[outputSize](initial_spline_size);
+        ThreadPool& pool = ThreadPool::global();
+
+        const size_t tasks = std::min<size_t>(pool.concurrency(),outputSize);
+
+        pool.parallel(tasks,[&](size_t task){
+
+            for( size_t id=task; id<outputSize; id+=tasks )
+            {
+                this->blocks[id].set_background(background);
+            }
+
+        });
     }
 
+    /*!
+        Fire for count samples at once. Inputs are transposed to input-major columns once,
+        then each block evaluates the whole batch spline by spline.
+    */
     template< size_t inputSize, size_t outputSize,class SplineClass >
-    SIMDVectorLite<outputSize> EvoKanLayer<inputSize,outputSize,SplineClass>::fire(const SIMDVectorLite<inputSize>& input)
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::fire(const SIMDVectorLite<inputSize>* inputs,size_t count,SIMDVectorLite<outputSize>* outputs) const
     {
-        size_t current_id = 0;
+        std::vector<number> columns;
 
-        std::mutex id_lock;
+        EvoKanLayer::transpose(inputs,count,columns);
 
-        std::thread threads[THREAD_COUNT];
+        // each block writes its own row of results
+        std::vector<number> results(outputSize*count,0.f);
 
-        for(size_t i=0;i<THREAD_COUNT;++i)
-        {
-            threads[i] = std::thread(EvoKanLayer::fire_thread,this->blocks,std::cref(input),std::ref(this->output),std::ref(current_id),std::ref(id_lock));
-        }
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            while( true )
+            {
+                const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
+
+                if( start >= outputSize )
+                {
+                    return;
+                }
 
-        for(size_t i=0;i<THREAD_COUNT;++i)
+                const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
+
+                // blocks get the same inputs, so thier splines tend to share nodes x,
+                // going through blocks in inner loop keeps search pattern repeating
+                for( size_t i=0; i<inputSize; ++i )
+                {
+                    const number* column = columns.data() + i*count;
+
+                    for( size_t id=start; id<end; ++id )
+                    {
+                        this->blocks[id].fire_input(i,column,count,results.data() + id*count);
+                    }
+                }
+            }
+
+        });
+
+        for( size_t s=0; s<count; ++s )
         {
-            if( threads[i].joinable() )
+            for( size_t id=0; id<outputSize; ++id )
             {
-                threads[i].join();
+                outputs[s][id] = results[id*count + s];
             }
         }
+    }
+
+    /*!
+        Fit layer, output is what fire returned for that input.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target)
+    {
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            EvoKanLayer::fit_thread(this->blocks,input,output,target,current_id);
 
-        return this->output;
+        });
 
     }
 
+    /*!
+        Fit layer when output for input isn't known, it fires layer first.
+    */
     template< size_t inputSize, size_t outputSize,class SplineClass >
     void EvoKanLayer<inputSize,outputSize,SplineClass>::fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target)
     {
-        size_t current_id = 0;
+        this->fit(input,this->fire(input),target);
+    }
+
+    /*!
+        Training step that fires and fits every block in one pass over its splines.
+        Returns layer output from before the update.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    SIMDVectorLite<outputSize> EvoKanLayer<inputSize,outputSize,SplineClass>::fire_and_fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target)
+    {
+        alignas(ARENA_LINE_SIZE) number output_slots[outputSize];
+
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
 
-        std::mutex id_lock;
+            while( true )
+            {
+                const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
 
-        std::thread threads[THREAD_COUNT];
+                if( start >= outputSize )
+                {
+                    return;
+                }
 
-        for(size_t i=0;i<THREAD_COUNT;++i)
+                const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
+
+                for( size_t id=start; id<end; ++id )
+                {
+                    output_slots[id] = this->blocks[id].fire_and_fit(input,target[id]);
+                }
+            }
+
+        });
+
+        SIMDVectorLite<outputSize> output;
+
+        for( size_t i=0; i<outputSize; ++i )
         {
-            threads[i] = std::thread(EvoKanLayer::fit_thread,this->blocks,std::cref(input),std::cref(this->output),std::cref(target),std::ref(current_id),std::ref(id_lock));
+            output[i] = output_slots[i];
         }
 
-        for(size_t i=0;i<THREAD_COUNT;++i)
-        {
-            if( threads[i].joinable() )
+        return output;
+    }
+
+    /*!
+        Fit for count samples at once. Outputs are computed for the whole batch first,
+        then every block accumulates nudges from all samples and applies them to each
+        spline in one pass. Node updates don't depend on sample order, so result is
+        the same for any split of work between threads.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::fit_batch(const SIMDVectorLite<inputSize>* inputs,const SIMDVectorLite<outputSize>* targets,size_t count)
+    {
+        std::vector<SIMDVectorLite<outputSize>> outputs(count);
+
+        this->fire(inputs,count,outputs.data());
+
+        std::vector<number> columns;
+
+        EvoKanLayer::transpose(inputs,count,columns);
+
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            std::vector<number> output(count);
+            std::vector<number> target(count);
+
+            // picked samples of every block in chunk
+            std::vector<size_t> active(EVO_KAN_LAYER_CHUNK*count);
+            std::vector<number> tar(EVO_KAN_LAYER_CHUNK*count);
+
+            size_t picked[EVO_KAN_LAYER_CHUNK];
+
+            while( true )
             {
-                threads[i].join();
+                const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
+
+                if( start >= outputSize )
+                {
+                    return;
+                }
+
+                const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
+
+                for( size_t id=start; id<end; ++id )
+                {
+                    for( size_t s=0; s<count; ++s )
+                    {
+                        output[s] = outputs[s][id];
+                        target[s] = targets[s][id];
+                    }
+
+                    const size_t row = (id - start)*count;
+
+                    picked[id - start] = EvoKan<inputSize,SplineClass>::select(count,output.data(),target.data(),active.data() + row,tar.data() + row);
+                }
+
+                // same order as in batched fire, inputs in outer loop
+                for( size_t i=0; i<inputSize; ++i )
+                {
+                    const number* column = columns.data() + i*count;
+
+                    for( size_t id=start; id<end; ++id )
+                    {
+                        const size_t row = (id - start)*count;
+
+                        if( picked[id - start] > 0 )
+                        {
+                            this->blocks[id].fit_input(i,column,active.data() + row,tar.data() + row,picked[id - start]);
+                        }
+                    }
+                }
+
+                // one new version per block, not per input
+                for( size_t id=start; id<end; ++id )
+                {
+                    if( picked[id - start] > 0 )
+                    {
+                        this->blocks[id].modified();
+                    }
+                }
             }
+
+        });
+    }
+
+    /*!
+        Copy parameters of all blocks from other layer.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    void EvoKanLayer<inputSize,outputSize,SplineClass>::copy_from(const EvoKanLayer& layer)
+    {
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            this->blocks[i].copy_from(layer.blocks[i]);
         }
-        
+    }
+
+    /*!
+        Build this layer from a trained one, for a frozen model used only for
+        inference, e.g. EvoKanLayer<in,out,SplineGrid<>>. Returns maximal absolute
+        difference between source and compiled spline over all splines of layer.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass >
+    template<class SourceSpline>
+    number EvoKanLayer<inputSize,outputSize,SplineClass>::compile(const EvoKanLayer<inputSize,outputSize,SourceSpline>& source)
+    {
+        number error = 0.f;
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            error = std::max<number>(error,this->blocks[i].compile(source.blocks[i]));
+        }
+
+        return error;
     }
 
     template< size_t inputSize, size_t outputSize,class SplineClass >
@@ -189,7 +640,8 @@ namespace snn
     template< size_t inputSize, size_t outputSize,class SplineClass >
     EvoKanLayer<inputSize,outputSize,SplineClass>::~EvoKanLayer()
     {
-        delete [] this->blocks;
+        // blocks, splines and nodes are placed in arena, so they are freed in one go
+        this->arena.clear();
     }
 
 
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include <evo_kan_layer.hpp>
+
+#include <simd_vector_lite.hpp>
+#include <config.hpp>
+
+namespace snn
+{
+    /*!
+        EvoKanLayer that can be trained while it serves inference.
+
+        It keeps two copies of layer. Readers call fire on published copy, while
+        a single training thread fits the other one. publish() swaps copies
+        atomically, waits until readers still using old copy leave it, and then
+        brings old copy up to date, so training can go on.
+
+        fire never waits for training and always sees one consistent version of
+        parameters, only publish() waits for readers, and they hold a copy only for
+        a single fire. Fire and fit share the pool, but a waiting fire runs only its
+        own tasks, never fit chunks queued by training thread.
+    */
+    template< size_t inputSize, size_t outputSize,class SplineClass = Spline >
+    class EvoKanLayerOnline
+    {
+        typedef EvoKanLayer<inputSize,outputSize,SplineClass> Layer;
+
+        // reader counters on separate lines, so readers of one copy don't slow the other
+        struct alignas(ARENA_LINE_SIZE) Readers
+        {
+            std::atomic<size_t> count;
+        };
+
+        Layer* layers[2];
+
+        mutable Readers readers[2];
+
+        // id of published copy
+        std::atomic<size_t> current;
+
+        /*!
+            Get id of published copy and mark it as used by caller.
+        */
+        size_t acquire() const
+        {
+            while( true )
+            {
+                const size_t id = this->current.load();
+
+                this->readers[id].count.fetch_add(1);
+
+                // copy could be swapped before it was marked
+                if( this->current.load() == id )
+                {
+                    return id;
+                }
+
+                this->readers[id].count.fetch_sub(1);
+            }
+        }
+
+        void release(size_t id) const
+        {
+            this->readers[id].count.fetch_sub(1,std::memory_order_release);
+        }
+
+        Layer& training()
+        {
+            return *this->layers[1 - this->current.load()];
+        }
+
+        public:
+
+        EvoKanLayerOnline( size_t initial_spline_size = 8 )
+        : current(0)
+        {
+            this->layers[0] = new Layer(initial_spline_size);
+            this->layers[1] = new Layer(initial_spline_size);
+
+            this->layers[1]->copy_from(*this->layers[0]);
+
+            this->readers[0].count = 0;
+            this->readers[1].count = 0;
+        }
+
+        EvoKanLayerOnline(const EvoKanLayerOnline&) = delete;
+
+        EvoKanLayerOnline& operator=(const EvoKanLayerOnline&) = delete;
+
+        /*!
+            Fire published copy, it can be called from any amount of threads.
+        */
+        SIMDVectorLite<outputSize> fire(const SIMDVectorLite<inputSize>& input) const
+        {
+            const size_t id = this->acquire();
+
+            SIMDVectorLite<outputSize> output = this->layers[id]->fire(input);
+
+            this->release(id);
+
+            return output;
+        }
+
+        /*!
+            Incremental fire of published copy. Copies share block versions after
+            publish(), so state keeps values of blocks that weren't trained since.
+        */
+        SIMDVectorLite<outputSize> fire(const SIMDVectorLite<inputSize>& input,EvoKanIncremental<inputSize,outputSize>& state) const
+        {
+            const size_t id = this->acquire();
+
+            SIMDVectorLite<outputSize> output = this->layers[id]->fire(input,state);
+
+            this->release(id);
+
+            return output;
+        }
+
+        void fire(const SIMDVectorLite<inputSize>* inputs,size_t count,SIMDVectorLite<outputSize>* outputs) const
+        {
+            const size_t id = this->acquire();
+
+            this->layers[id]->fire(inputs,count,outputs);
+
+            this->release(id);
+        }
+
+        /*!
+            Fit training copy, changes are visible to readers after publish().
+            Only one thread can train.
+        */
+        void fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target)
+        {
+            this->training().fit(input,target);
+        }
+
+        void fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target)
+        {
+            this->training().fit(input,output,target);
+        }
+
+        void fit_batch(const SIMDVectorLite<inputSize>* inputs,const SIMDVectorLite<outputSize>* targets,size_t count)
+        {
+            this->training().fit_batch(inputs,targets,count);
+        }
+
+        /*!
+            Make training copy visible to readers. Called by training thread.
+        */
+        void publish()
+        {
+            const size_t old = this->current.load();
+
+            this->current.store(1 - old);
+
+            // readers that got old copy before swap are still firing it
+            while( this->readers[old].count.load(std::memory_order_acquire) > 0 )
+            {
+                std::this_thread::yield();
+            }
+
+            this->layers[old]->copy_from(*this->layers[1 - old]);
+        }
+
+        void save(std::ostream& out) const
+        {
+            const size_t id = this->acquire();
+
+            this->layers[id]->save(out);
+
+            this->release(id);
+        }
+
+        /*!
+            Load parameters into both copies, it cannot be called while layer is in use.
+        */
+        void load(std::istream& in)
+        {
+            const size_t id = this->current.load();
+
+            this->layers[id]->load(in);
+
+            this->layers[1 - id]->copy_from(*this->layers[id]);
+        }
+
+        ~EvoKanLayerOnline()
+        {
+            delete this->layers[0];
+            delete this->layers[1];
+        }
+
+    };
+
+}
@@ -0,0 +1,500 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+#include <evo_kan_layer.hpp>
+#include <static_kan_spline.hpp>
+#include <arena.hpp>
+#include <thread_pool.hpp>
+
+#include <simd_vector_lite.hpp>
+#include <config.hpp>
+
+namespace snn
+{
+    /*!
+        EvoKanLayer where splines of input i of all outputs share one vector of Knots
+        knots x, like EvoKanLayer<in,out,SplineStatic<Knots>> with all blocks keeping
+        the same grid.
+
+        Parameters are stored input-major. For each input there are Knots x values,
+        followed by rows of y, one row per knot holding value of that knot for every
+        output. Segment of input i is searched once for all outputs, and then layer
+        output is accumulated by sweeping two rows of y, so fire costs about as much
+        as multiplication of matrix by vector.
+
+        Fit does what SplineStatic::fit does for every output. Moving knot x doesn't
+        depend on target, so it is applied once for all outputs that are fitted.
+
+        It is saved in EvoKanLayer format, so it can be loaded into EvoKanLayer with
+        SplineStatic<Knots>, and back when all blocks share knots.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots = EVO_KAN_SHARED_KNOTS >
+    class EvoKanLayerShared
+    {
+        static_assert(Knots > 1,"EvoKanLayerShared requires at least two knots");
+
+        protected:
+
+        static constexpr size_t chunk_count = ( outputSize + EVO_KAN_LAYER_CHUNK - 1 )/EVO_KAN_LAYER_CHUNK;
+
+        // rows of y are padded to whole chunks, so workers always sweep full chunks
+        static constexpr size_t stride = chunk_count*EVO_KAN_LAYER_CHUNK;
+
+        /*!
+            Segment of a single input, shared by all outputs.
+        */
+        struct Segment
+        {
+            // left knot of segment, or SPLINE_NO_NODE when input doesn't add anything
+            size_t left;
+
+            // position of input between left and right knot
+            number t;
+
+            // knot nudged by fit, or SPLINE_NO_NODE
+            size_t node;
+
+            // whether fit moves x of node too, or only its y
+            bool move_x;
+        };
+
+        Arena arena;
+
+        number* knots_x;
+
+        number* knots_y;
+
+        number* row(size_t input,size_t knot) const
+        {
+            return this->knots_y + ( input*Knots + knot )*stride;
+        }
+
+        void segments(const number* x,Segment* segments) const;
+
+        void fire(const Segment* segments,number* output) const;
+
+        void fit(const number* x,const Segment* segments,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target);
+
+        public:
+
+        EvoKanLayerShared();
+
+        EvoKanLayerShared(const EvoKanLayerShared&) = delete;
+
+        EvoKanLayerShared& operator=(const EvoKanLayerShared&) = delete;
+
+        SIMDVectorLite<outputSize> fire(const SIMDVectorLite<inputSize>& input) const;
+
+        void fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target);
+
+        void fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target);
+
+        SIMDVectorLite<outputSize> fire_and_fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target);
+
+        void save(std::ostream& out) const;
+
+        void load(std::istream& in);
+
+        ~EvoKanLayerShared();
+
+    };
+
+
+    /*!
+        Unlike EvoKanLayer it takes no spline size, every input has Knots knots.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    EvoKanLayerShared<inputSize,outputSize,Knots>::EvoKanLayerShared()
+    {
+        this->knots_x = this->arena.template allocate_array<number>(inputSize*Knots);
+
+        this->knots_y = this->arena.template allocate_array<number>(inputSize*Knots*stride);
+
+        const number step = ( DEF_X_RIGHT - DEF_X_LEFT )/(Knots-1);
+
+        DEF_Y_INIT init;
+
+        for( size_t i=0; i<inputSize; ++i )
+        {
+            for( size_t k=0; k<Knots; ++k )
+            {
+                this->knots_x[i*Knots + k] = DEF_X_LEFT + step*k;
+
+                number* y = this->row(i,k);
+
+                for( size_t o=0; o<stride; ++o )
+                {
+                    y[o] = o < outputSize ? init.init() : 0.f;
+                }
+            }
+        }
+    }
+
+    /*!
+        Find segment of every input, it is what SplineStatic::search and fit decide,
+        done once for all outputs.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::segments(const number* x,Segment* segments) const
+    {
+        for( size_t i=0; i<inputSize; ++i )
+        {
+            const number* knots = this->knots_x + i*Knots;
+
+            Segment& segment = segments[i];
+
+            segment.left = SPLINE_NO_NODE;
+            segment.t = 0.f;
+            segment.node = SPLINE_NO_NODE;
+            segment.move_x = false;
+
+            // outside of knots spline gives 0 and fit does nothing
+            if( x[i] < knots[0] || x[i] > knots[Knots-1] )
+            {
+                continue;
+            }
+
+            const size_t p = std::min<size_t>(SplineStatic<Knots>::lower_node(knots,x[i]),Knots-2);
+
+            const number left_x = knots[p];
+            const number right_x = knots[p+1];
+
+            if( left_x != right_x )
+            {
+                segment.left = p;
+
+                segment.t = ( x[i] - left_x )/( right_x - left_x );
+            }
+            else if( left_x == x[i] )
+            {
+                segment.left = p;
+            }
+
+            number dx_left = left_x - x[i];
+            number dx_right = right_x - x[i];
+
+            dx_left *= dx_left;
+            dx_right *= dx_right;
+
+            if( dx_left != dx_right )
+            {
+                segment.node = dx_left < dx_right ? p : p+1;
+
+                segment.move_x = true;
+            }
+            else if( left_x == x[i] )
+            {
+                segment.node = p;
+            }
+            else if( right_x == x[i] )
+            {
+                segment.node = p+1;
+            }
+        }
+    }
+
+    /*!
+        Sum rows of y picked by segments, workers take chunks of EVO_KAN_LAYER_CHUNK
+        outputs and sweep them over all inputs.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::fire(const Segment* segments,number* output) const
+    {
+        std::atomic<size_t> current_id(0);
+
+        ThreadPool& pool = ThreadPool::global();
+
+        pool.parallel(std::min<size_t>(pool.concurrency(),chunk_count),[&](size_t){
+
+            while( true )
+            {
+                const size_t start = current_id.fetch_add(EVO_KAN_LAYER_CHUNK,std::memory_order_relaxed);
+
+                if( start >= outputSize )
+                {
+                    return;
+                }
+
+                alignas(ARENA_LINE_SIZE) number sum[EVO_KAN_LAYER_CHUNK] = {0};
+
+                for( size_t i=0; i<inputSize; ++i )
+                {
+                    const Segment& segment = segments[i];
+
+                    if( segment.left == SPLINE_NO_NODE )
+                    {
+                        continue;
+                    }
+
+                    const number* y_left = this->row(i,segment.left) + start;
+
+                    // left knot of degenerated segment has t equal 0, so right row isn't used
+                    const number* y_right = this->row(i,std::min<size_t>(segment.left+1,Knots-1)) + start;
+
+                    const number t = segment.t;
+
+                    for( size_t o=0; o<EVO_KAN_LAYER_CHUNK; ++o )
+                    {
+                        sum[o] += y_left[o] + t*( y_right[o] - y_left[o] );
+                    }
+                }
+
+                const size_t end = std::min<size_t>(start + EVO_KAN_LAYER_CHUNK,outputSize);
+
+                for( size_t o=start; o<end; ++o )
+                {
+                    output[o] = sum[o - start];
+                }
+            }
+
+        });
+    }
+
+    /*!
+        Nudge knots picked by segments for outputs whose output is too far from target.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::fit(const number* x,const Segment* segments,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target)
+    {
+        // outputs that don't need fitting get rate 0, so rows are swept without branches
+        alignas(ARENA_LINE_SIZE) number rate[stride] = {0};
+        alignas(ARENA_LINE_SIZE) number tar[stride] = {0};
+
+        size_t fitted = 0;
+
+        for( size_t o=0; o<outputSize; ++o )
+        {
+            if( abs(target[o] - output[o]) < ERROR_THRESHOLD_FOR_FIT )
+            {
+                continue;
+            }
+
+            rate[o] = 0.1f;
+
+            tar[o] = target[o]/static_cast<number>(inputSize);
+
+            fitted++;
+        }
+
+        if( fitted == 0 )
+        {
+            return;
+        }
+
+        ThreadPool& pool = ThreadPool::global();
+
+        const size_t tasks = std::min<size_t>(pool.concurrency(),inputSize);
+
+        pool.parallel(tasks,[&](size_t task){
+
+            for( size_t i=task; i<inputSize; i+=tasks )
+            {
+                const Segment& segment = segments[i];
+
+                if( segment.node == SPLINE_NO_NODE )
+                {
+                    continue;
+                }
+
+                number* y = this->row(i,segment.node);
+
+                for( size_t o=0; o<stride; ++o )
+                {
+                    y[o] -= rate[o]*( y[o] - tar[o] );
+                }
+
+                if( segment.move_x )
+                {
+                    number& knot = this->knots_x[i*Knots + segment.node];
+
+                    knot -= 0.1f*( knot - x[i] );
+                }
+            }
+
+        });
+    }
+
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    SIMDVectorLite<outputSize> EvoKanLayerShared<inputSize,outputSize,Knots>::fire(const SIMDVectorLite<inputSize>& input) const
+    {
+        alignas(SPLINE_NODE_ALIGNMENT) number x[inputSize];
+
+        input.copy_to(x);
+
+        Segment segments[inputSize];
+
+        this->segments(x,segments);
+
+        alignas(ARENA_LINE_SIZE) number output_slots[outputSize];
+
+        this->fire(segments,output_slots);
+
+        SIMDVectorLite<outputSize> output;
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            output[i] = output_slots[i];
+        }
+
+        return output;
+    }
+
+    /*!
+        Fit layer, output is what fire returned for that input.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& output,const SIMDVectorLite<outputSize>& target)
+    {
+        alignas(SPLINE_NODE_ALIGNMENT) number x[inputSize];
+
+        input.copy_to(x);
+
+        Segment segments[inputSize];
+
+        this->segments(x,segments);
+
+        this->fit(x,segments,output,target);
+    }
+
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target)
+    {
+        this->fire_and_fit(input,target);
+    }
+
+    /*!
+        Training step, segments are searched once and used by both fire and fit.
+        Returns layer output from before the update.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    SIMDVectorLite<outputSize> EvoKanLayerShared<inputSize,outputSize,Knots>::fire_and_fit(const SIMDVectorLite<inputSize>& input,const SIMDVectorLite<outputSize>& target)
+    {
+        alignas(SPLINE_NODE_ALIGNMENT) number x[inputSize];
+
+        input.copy_to(x);
+
+        Segment segments[inputSize];
+
+        this->segments(x,segments);
+
+        alignas(ARENA_LINE_SIZE) number output_slots[outputSize];
+
+        this->fire(segments,output_slots);
+
+        SIMDVectorLite<outputSize> output;
+
+        for( size_t i=0; i<outputSize; ++i )
+        {
+            output[i] = output_slots[i];
+        }
+
+        this->fit(x,segments,output,target);
+
+        return output;
+    }
+
+    /*!
+        Layer is saved block by block, each spline as Knots nodes, like EvoKanLayer does.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::save(std::ostream& out) const
+    {
+        out.write(EVO_KAN_LAYER_HEADER,strlen(EVO_KAN_LAYER_HEADER));
+
+        constexpr size_t buffor_size = SplineNode::size_for_serialization();
+
+        char buffer[buffor_size];
+
+        char len_buffer[4];
+
+        uint32_t len = Knots;
+
+        memmove(len_buffer,(char*)&len,4);
+
+        for( size_t o=0; o<outputSize; ++o )
+        {
+            for( size_t i=0; i<inputSize; ++i )
+            {
+                out.write(len_buffer,4);
+
+                for( size_t k=0; k<Knots; ++k )
+                {
+                    SplineNode(this->knots_x[i*Knots + k],this->row(i,k)[o]).serialize(buffer);
+
+                    out.write(buffer,buffor_size);
+                }
+            }
+        }
+    }
+
+    /*!
+        Load layer saved in EvoKanLayer format, splines of every input have to share knots.
+    */
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    void EvoKanLayerShared<inputSize,outputSize,Knots>::load(std::istream& in)
+    {
+        char header[strlen(EVO_KAN_LAYER_HEADER)];
+
+        in.read(header,strlen(EVO_KAN_LAYER_HEADER));
+
+        if( strncmp(header,EVO_KAN_LAYER_HEADER,strlen(EVO_KAN_LAYER_HEADER)) != 0)
+        {
+            throw std::runtime_error("Header mismatch in byte stream!!!");
+        }
+
+        constexpr size_t buffor_size = SplineNode::size_for_serialization();
+
+        char buffer[buffor_size];
+
+        char len_buffer[4];
+
+        SplineNode node;
+
+        for( size_t o=0; o<outputSize; ++o )
+        {
+            for( size_t i=0; i<inputSize; ++i )
+            {
+                in.read(len_buffer,4);
+
+                uint32_t nodes_to_read;
+
+                memmove((char*)&nodes_to_read,len_buffer,4);
+
+                if( nodes_to_read != Knots )
+                {
+                    throw std::runtime_error("Spline node count mismatch in byte stream!!!");
+                }
+
+                for( size_t k=0; k<Knots; ++k )
+                {
+                    in.read(buffer,buffor_size);
+
+                    node.deserialize(buffer);
+
+                    number& knot = this->knots_x[i*Knots + k];
+
+                    if( o == 0 )
+                    {
+                        knot = node.x;
+                    }
+                    else if( knot != node.x )
+                    {
+                        throw std::runtime_error("Knot mismatch in byte stream!!!");
+                    }
+
+                    this->row(i,k)[o] = node.y;
+                }
+            }
+        }
+    }
+
+    template< size_t inputSize, size_t outputSize, size_t Knots >
+    EvoKanLayerShared<inputSize,outputSize,Knots>::~EvoKanLayerShared()
+    {
+        this->arena.clear();
+    }
+
+}
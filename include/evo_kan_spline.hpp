@@ -1,11 +1,16 @@
 #pragma once
 
 #include <vector>
+#include <new>
+#include <cstring>
+#include <algorithm>
 
 #include <simd_vector_lite.hpp>
 #include <misc.hpp>
+#include <half_number.hpp>
 
 #include <evo_kan_spline_node.hpp>
+#include <arena.hpp>
 #include <config.hpp>
 
 namespace snn
@@ -13,24 +18,66 @@ namespace snn
 
     /*!
         A class that represents spline curve used by EVO KAN as activations function.
+
+        Nodes are stored as two aligned arrays, one with x and one with y coordinates,
+        kept sorted by x. When spline is given an Arena, arrays are taken from it and
+        free slots left after removed nodes are reused by next insertions.
+
+        Nodes are stored as Storage, e.g. half or bfloat16 from half_number.hpp, and
+        converted to number for every computation, like in SplineStatic. Points given
+        to fit are rounded to Storage first, so a point that lands on stored node
+        nudges it instead of adding a copy.
     */
-    class Spline
+    template<class Storage = SPLINE_STORAGE>
+    class BasicSpline
     {
         protected:
 
-        std::vector<SplineNode*> nodes;
+        Storage* nodes_x;
+
+        Storage* nodes_y;
+
+        size_t count;
+
+        size_t capacity;
+
+        Arena* arena;
+
+        static number stored(number x)
+        {
+            return static_cast<number>(static_cast<Storage>(x));
+        }
+
+        Storage* allocate_nodes(size_t capacity);
+
+        void free_nodes(Storage* nodes,size_t capacity);
+
+        void reserve(size_t capacity);
 
         void sort_nodes();
 
-        void add_node(SplineNode* node);
+        void add_node(number x,number y);
+
+        void remove_node(size_t index);
 
         public:
 
-        Spline( size_t initial_size = 8 );
-        
+        // splines that can be trained
+        static constexpr bool read_only = false;
+
+        BasicSpline( size_t initial_size = 8 , Arena* arena = nullptr );
+
+        BasicSpline(const BasicSpline& spline);
+
+        BasicSpline& operator=(const BasicSpline& spline);
+
         void fit(number x,number y);
 
-        std::pair<SplineNode*,SplineNode*> search(number x);
+        void fit(number x,number y,std::pair<size_t,size_t> nodes);
+
+        void fit_batch(const number* x,const number* y,size_t count);
+
+        std::pair<size_t,size_t> search(number x) const;
 
         void remove_redudant_points();
 
@@ -40,7 +87,22 @@ namespace snn
 
         void simplify();
 
-        number fire(number x);
+        number fire(number x) const;
+
+        const Storage* get_x() const
+        {
+            return this->nodes_x;
+        }
+
+        const Storage* get_y() const
+        {
+            return this->nodes_y;
+        }
+
+        size_t length() const
+        {
+            return this->count;
+        }
 
         void printInfo(std::ostream& out);
 
@@ -48,45 +110,159 @@ namespace snn
 
         void load(std::istream& out);
 
-        ~Spline();
+        ~BasicSpline();
 
     };
 
+    typedef BasicSpline<> Spline;
+
+
+    template<class Storage>
+    Storage* BasicSpline<Storage>::allocate_nodes(size_t capacity)
+    {
+        if( this->arena )
+        {
+            return static_cast<Storage*>(this->arena->allocate(capacity*sizeof(Storage),SPLINE_NODE_ALIGNMENT));
+        }
+
+        return new (std::align_val_t(SPLINE_NODE_ALIGNMENT)) Storage[capacity];
+    }
+
+    template<class Storage>
+    void BasicSpline<Storage>::free_nodes(Storage* nodes,size_t capacity)
+    {
+        if( this->arena )
+        {
+            this->arena->release(nodes,capacity*sizeof(Storage));
+
+            return;
+        }
+
+        ::operator delete[](nodes,std::align_val_t(SPLINE_NODE_ALIGNMENT));
+    }
+
+    /*!
+        Grow node arrays so they can hold at least capacity nodes.
+    */
+    template<class Storage>
+    void BasicSpline<Storage>::reserve(size_t capacity)
+    {
+        if( capacity <= this->capacity )
+        {
+            return;
+        }
+
+        if( this->arena )
+        {
+            // arena hands out whole lines, so use all of them
+            const size_t line_nodes = ARENA_LINE_SIZE/sizeof(Storage);
+
+            capacity = ( ( capacity + line_nodes - 1 )/line_nodes )*line_nodes;
+        }
+
+        Storage* new_x = this->allocate_nodes(capacity);
+        Storage* new_y = this->allocate_nodes(capacity);
+
+        if( this->count > 0 )
+        {
+            memcpy(new_x,this->nodes_x,this->count*sizeof(Storage));
+            memcpy(new_y,this->nodes_y,this->count*sizeof(Storage));
+        }
+
+        if( this->nodes_x )
+        {
+            this->free_nodes(this->nodes_x,this->capacity);
+            this->free_nodes(this->nodes_y,this->capacity);
+        }
+
+        this->nodes_x = new_x;
+        this->nodes_y = new_y;
+
+        this->capacity = capacity;
+    }
 
     /*!
             In order for function to work, nodes has to be sorted in asceding order.
     */
-    void Spline::sort_nodes()
+    template<class Storage>
+    void BasicSpline<Storage>::sort_nodes()
     {
-        std::sort(this->nodes.begin(),this->nodes.end(),[](SplineNode* a, SplineNode* b)
+        std::vector<SplineNode> nodes;
+
+        nodes.reserve(this->count);
+
+        for(size_t i=0;i<this->count;++i)
+        {
+            nodes.push_back(SplineNode(this->nodes_x[i],this->nodes_y[i]));
+        }
+
+        std::sort(nodes.begin(),nodes.end(),[](const SplineNode& a,const SplineNode& b)
                 {
-                    return a->x < b->x;
+                    return a.x < b.x;
                 });
+
+        for(size_t i=0;i<this->count;++i)
+        {
+            this->nodes_x[i] = nodes[i].x;
+            this->nodes_y[i] = nodes[i].y;
+        }
     }
 
     /*
         Use insertion sort to keep nodes sorted during node insertion.
     */
-    void Spline::add_node(SplineNode* node)
+    template<class Storage>
+    void BasicSpline<Storage>::add_node(number x,number y)
     {
-        auto loc = std::lower_bound(this->nodes.begin(),this->nodes.end(),node->x,
-        [](SplineNode* a,number x){
+        if( this->count == this->capacity )
+        {
+            this->reserve(std::max<size_t>(2*this->capacity,8));
+        }
 
-            return a->x < x;
-        });
+        size_t loc = std::lower_bound(this->nodes_x,this->nodes_x+this->count,x,[](const Storage& node,number x)
+                {
+                    return static_cast<number>(node) < x;
+                }) - this->nodes_x;
+
+        const size_t to_move = this->count - loc;
+
+        memmove(this->nodes_x+loc+1,this->nodes_x+loc,to_move*sizeof(Storage));
+        memmove(this->nodes_y+loc+1,this->nodes_y+loc,to_move*sizeof(Storage));
+
+        this->nodes_x[loc] = x;
+        this->nodes_y[loc] = y;
+
+        this->count++;
+    }
+
+    template<class Storage>
+    void BasicSpline<Storage>::remove_node(size_t index)
+    {
+        const size_t to_move = this->count - index - 1;
+
+        memmove(this->nodes_x+index,this->nodes_x+index+1,to_move*sizeof(Storage));
+        memmove(this->nodes_y+index,this->nodes_y+index+1,to_move*sizeof(Storage));
 
-        this->nodes.insert(loc,node);
+        this->count--;
     }
 
-    Spline::Spline( size_t initial_size )
+    template<class Storage>
+    BasicSpline<Storage>::BasicSpline( size_t initial_size , Arena* arena )
     {
+        this->arena = arena;
+
+        this->nodes_x = nullptr;
+        this->nodes_y = nullptr;
+
+        this->count = 0;
+        this->capacity = 0;
 
         if( initial_size == 0 )
         {
             return;
         }
 
-        this->nodes.reserve(initial_size);
+        this->reserve(initial_size+1);
 
 
         number min_x = DEF_X_LEFT;
@@ -95,76 +271,127 @@ namespace snn
         const number step = ( max_x - min_x )/initial_size;
 
         DEF_Y_INIT init;
-        
+
         while( min_x <= max_x )
         {
             number y = init.init();
 
-            SplineNode *node = new SplineNode(min_x,y);
+            if( this->count == this->capacity )
+            {
+                this->reserve(this->capacity+1);
+            }
+
+            this->nodes_x[this->count] = min_x;
+            this->nodes_y[this->count] = y;
 
-            this->nodes.push_back(node);
+            this->count++;
 
             min_x += step;
         }
 
     }
-    
+
+    /*!
+        Copy nodes of other spline to heap, arena of spline belongs to its owner.
+    */
+    template<class Storage>
+    BasicSpline<Storage>::BasicSpline(const BasicSpline& spline)
+    : BasicSpline(0)
+    {
+        *this = spline;
+    }
+
+    /*!
+        Copy nodes of other spline, memory comes from this spline arena.
+    */
+    template<class Storage>
+    BasicSpline<Storage>& BasicSpline<Storage>::operator=(const BasicSpline& spline)
+    {
+        if( this == &spline )
+        {
+            return *this;
+        }
+
+        this->count = 0;
+
+        this->reserve(spline.count);
+
+        if( spline.count > 0 )
+        {
+            memcpy(this->nodes_x,spline.nodes_x,spline.count*sizeof(Storage));
+            memcpy(this->nodes_y,spline.nodes_y,spline.count*sizeof(Storage));
+        }
+
+        this->count = spline.count;
+
+        return *this;
+    }
+
     /*!
 
         Update spline with new point.
-    
+
     */
-    void Spline::fit(number x,number y)
+    template<class Storage>
+    void BasicSpline<Storage>::fit(number x,number y)
     {
-        // Check if point exists aleardy in spline
-        std::pair<SplineNode*,SplineNode*> nodes = this->search(x);
+        this->fit(x,y,this->search(x));
+    }
+
+    /*!
+        Update spline with new point, nodes is result of search for x.
+    */
+    template<class Storage>
+    void BasicSpline<Storage>::fit(number x,number y,std::pair<size_t,size_t> nodes)
+    {
+        const bool has_left = nodes.first != SPLINE_NO_NODE;
+        const bool has_right = nodes.second != SPLINE_NO_NODE;
+
+        // rounding can't move x past a node, so nodes stay valid
+        x = BasicSpline::stored(x);
 
         // Check if points swarming is possible
-        if( nodes.first && nodes.second )
+        if( has_left && has_right )
         {
-            SplineNode* left = nodes.first;
-            SplineNode* right = nodes.second;
-
-            SIMDVectorLite<2> dx;
+            Storage& left_x = this->nodes_x[nodes.first];
+            Storage& left_y = this->nodes_y[nodes.first];
 
-            dx[0] = left->x;
-            dx[1] = right->x;
+            Storage& right_x = this->nodes_x[nodes.second];
+            Storage& right_y = this->nodes_y[nodes.second];
 
-            dx -= x;
+            number dx_left = static_cast<number>(left_x) - x;
+            number dx_right = static_cast<number>(right_x) - x;
 
-            dx*=dx;
+            dx_left *= dx_left;
+            dx_right *= dx_right;
 
             // if x is closer to left nudge left point
-            if(dx[0] < dx[1]  && dx[0] < ERROR_THRESHOLD_FOR_INSERTION)
+            if(dx_left < dx_right  && dx_left < ERROR_THRESHOLD_FOR_INSERTION)
             {
-                left->y -= 0.1f*( left->y - y );
-                
-                left->x -= 0.01f*( left->x - x );
+                left_y -= 0.1f*( static_cast<number>(left_y) - y );
+
+                left_x -= 0.01f*( static_cast<number>(left_x) - x );
 
                 // if points are very close to each other remove one of them
-                if( abs( left->x - right->x ) < ERROR_THRESHOLD_FOR_POINT_REMOVAL)
+                if( abs( static_cast<number>(left_x) - static_cast<number>(right_x) ) < ERROR_THRESHOLD_FOR_POINT_REMOVAL)
                 {
-                    this->nodes.erase(this->nodes.begin()+left->index);
+                    this->remove_node(nodes.first);
                 }
 
-                // this->sort_nodes();
-
                 return;
             }
             // if x is closer to right nudge right point
-            else if(dx[1] < dx[0] && dx[1] < ERROR_THRESHOLD_FOR_INSERTION)
+            else if(dx_right < dx_left && dx_right < ERROR_THRESHOLD_FOR_INSERTION)
             {
-                right->y -= 0.1f*( right->y - y );
+                right_y -= 0.1f*( static_cast<number>(right_y) - y );
 
-                right->x -= 0.01f*( right->x - x );
+                right_x -= 0.01f*( static_cast<number>(right_x) - x );
 
                 // if points are very close to each other remove one of them
-                if( abs( left->x - right->x ) < ERROR_THRESHOLD_FOR_POINT_REMOVAL)
+                if( abs( static_cast<number>(left_x) - static_cast<number>(right_x) ) < ERROR_THRESHOLD_FOR_POINT_REMOVAL)
                 {
-                    this->nodes.erase(this->nodes.begin()+right->index);
+                    this->remove_node(nodes.second);
                 }
-                
-                // this->sort_nodes();
 
                 return;
             }
@@ -172,159 +399,310 @@ namespace snn
         }
 
         // if x is equal to one of the nodes x, nudge y
-        if( nodes.first && nodes.first->x == x )
+        if( has_left && this->nodes_x[nodes.first] == x )
         {
-            SplineNode* left = nodes.first;
+            Storage& left_y = this->nodes_y[nodes.first];
 
-            left->y -= 0.1f*( left->y - y );
+            left_y -= 0.1f*( static_cast<number>(left_y) - y );
 
             return;
         }
         // if x is equal to one of the nodes x, nudge y
-        if( nodes.second && nodes.second->x == x )
+        if( has_right && this->nodes_x[nodes.second] == x )
         {
-            SplineNode* right = nodes.second;
+            Storage& right_y = this->nodes_y[nodes.second];
 
-            right->y -= 0.1f*( right->y - y );
+            right_y -= 0.1f*( static_cast<number>(right_y) - y );
 
             return;
         }
 
-        // // if there is no such point present insert it into spline.
-        SplineNode* node = new SplineNode(x,y);
-
-        // this->nodes.push_back(node);
-
-        // this->sort_nodes();
-
-        this->add_node(node);
+        // if there is no such point present insert it into spline.
+        this->add_node(x,y);
     }
 
     /*!
-        It use binary search to find pair of points with x between them.
+        Update spline with count points at once. Every point picks its node the same
+        way as fit does, but against nodes from before the batch. Nudges are summed per
+        node and applied in one pass, k nudges towards mean target move a node by
+        1 - 0.9^k of the distance, like k calls to fit with the same target would.
+
+        New nodes are merged in and too close nodes are removed only at the end.
     */
-    std::pair<SplineNode*,SplineNode*> Spline::search(number x)
+    template<class Storage>
+    void BasicSpline<Storage>::fit_batch(const number* x,const number* y,size_t count)
     {
+        static thread_local std::vector<number> target_x;
+        static thread_local std::vector<number> target_y;
+
+        static thread_local std::vector<uint32_t> hits_x;
+        static thread_local std::vector<uint32_t> hits_y;
+
+        static thread_local std::vector<SplineNode> pending;
+
+        target_x.assign(this->count,0.f);
+        target_y.assign(this->count,0.f);
+
+        hits_x.assign(this->count,0);
+        hits_y.assign(this->count,0);
+
+        pending.clear();
+
+        for(size_t s=0;s<count;++s)
+        {
+            std::pair<size_t,size_t> nodes = this->search(x[s]);
+
+            const number xs = BasicSpline::stored(x[s]);
+
+            const bool has_left = nodes.first != SPLINE_NO_NODE;
+            const bool has_right = nodes.second != SPLINE_NO_NODE;
+
+            if( has_left && has_right )
+            {
+                number dx_left = static_cast<number>(this->nodes_x[nodes.first]) - xs;
+                number dx_right = static_cast<number>(this->nodes_x[nodes.second]) - xs;
+
+                dx_left *= dx_left;
+                dx_right *= dx_right;
+
+                size_t id = SPLINE_NO_NODE;
+
+                if( dx_left < dx_right && dx_left < ERROR_THRESHOLD_FOR_INSERTION )
+                {
+                    id = nodes.first;
+                }
+                else if( dx_right < dx_left && dx_right < ERROR_THRESHOLD_FOR_INSERTION )
+                {
+                    id = nodes.second;
+                }
+
+                if( id != SPLINE_NO_NODE )
+                {
+                    target_x[id] += xs;
+                    target_y[id] += y[s];
+
+                    hits_x[id]++;
+                    hits_y[id]++;
+
+                    continue;
+                }
+            }
+
+            if( has_left && this->nodes_x[nodes.first] == xs )
+            {
+                target_y[nodes.first] += y[s];
+
+                hits_y[nodes.first]++;
+
+                continue;
+            }
+
+            if( has_right && this->nodes_x[nodes.second] == xs )
+            {
+                target_y[nodes.second] += y[s];
 
-        if( this->nodes.size() == 0 )
+                hits_y[nodes.second]++;
+
+                continue;
+            }
+
+            pending.push_back(SplineNode(xs,y[s]));
+        }
+
+        // apply all nudges in one pass over nodes
+        for(size_t i=0;i<this->count;++i)
         {
-            return std::pair<SplineNode*,SplineNode*>(nullptr,nullptr);
+            if( hits_y[i] > 0 )
+            {
+                const number rate = nudge_rate(0.1f,hits_y[i]);
+
+                this->nodes_y[i] -= rate*( static_cast<number>(this->nodes_y[i]) - target_y[i]/hits_y[i] );
+            }
+
+            if( hits_x[i] > 0 )
+            {
+                const number rate = nudge_rate(0.01f,hits_x[i]);
+
+                this->nodes_x[i] -= rate*( static_cast<number>(this->nodes_x[i]) - target_x[i]/hits_x[i] );
+            }
+        }
+
+        // merge new nodes from the back, so nodes are moved only once
+        if( !pending.empty() )
+        {
+            std::sort(pending.begin(),pending.end(),[](const SplineNode& a,const SplineNode& b)
+                {
+                    return a.x < b.x;
+                });
+
+            this->reserve(this->count + pending.size());
+
+            size_t old_id = this->count;
+            size_t new_id = pending.size();
+
+            size_t out_id = this->count + pending.size();
+
+            while( new_id > 0 )
+            {
+                out_id--;
+
+                if( old_id > 0 && static_cast<number>(this->nodes_x[old_id-1]) > pending[new_id-1].x )
+                {
+                    old_id--;
+
+                    this->nodes_x[out_id] = this->nodes_x[old_id];
+                    this->nodes_y[out_id] = this->nodes_y[old_id];
+                }
+                else
+                {
+                    new_id--;
+
+                    this->nodes_x[out_id] = pending[new_id].x;
+                    this->nodes_y[out_id] = pending[new_id].y;
+                }
+            }
+
+            this->count += pending.size();
         }
 
-        if( this->nodes.size() == 1 )
+        // remove nodes that ended up too close to previous one
+        if( this->count > 1 )
         {
-            this->nodes[0]->index = 0;
+            size_t last = 0;
+
+            for(size_t i=1;i<this->count;++i)
+            {
+                if( abs( static_cast<number>(this->nodes_x[i]) - static_cast<number>(this->nodes_x[last]) ) < ERROR_THRESHOLD_FOR_POINT_REMOVAL )
+                {
+                    continue;
+                }
+
+                last++;
 
-            return std::pair<SplineNode*,SplineNode*>(this->nodes[0],this->nodes[0]);
+                this->nodes_x[last] = this->nodes_x[i];
+                this->nodes_y[last] = this->nodes_y[i];
+            }
+
+            this->count = last + 1;
         }
+    }
+
+    /*!
+        It use binary search to find pair of points with x between them, it doesn't
+        modify spline so it can be called from many threads at once.
+
+        Returns indexes of left and right node, SPLINE_NO_NODE marks missing node.
+    */
+    template<class Storage>
+    std::pair<size_t,size_t> BasicSpline<Storage>::search(number x) const
+    {
 
-        if( x < this->nodes[0]->x )
+        if( this->count == 0 )
         {
-            this->nodes[0]->index = 0;
+            return std::pair<size_t,size_t>(SPLINE_NO_NODE,SPLINE_NO_NODE);
+        }
 
-            return std::pair<SplineNode*,SplineNode*>(nullptr,this->nodes[0]);
+        if( this->count == 1 )
+        {
+            return std::pair<size_t,size_t>(0,0);
         }
-        
-        if( x > this->nodes[this->nodes.size()-1]->x )
+
+        if( x < this->nodes_x[0] )
         {
-            this->nodes[this->nodes.size()-1]->index = this->nodes.size()-1;
+            return std::pair<size_t,size_t>(SPLINE_NO_NODE,0);
+        }
 
-            return std::pair<SplineNode*,SplineNode*>(this->nodes[this->nodes.size()-1],nullptr);
+        if( x > this->nodes_x[this->count-1] )
+        {
+            return std::pair<size_t,size_t>(this->count-1,SPLINE_NO_NODE);
         }
 
 
         size_t p = 0;
-        size_t q = this->nodes.size()-1;
+        size_t q = this->count-1;
 
         size_t center = (p+q)/2;
 
         while( (q-p) > 1 )
         {
-            SplineNode* center_node = this->nodes[center];
+            number center_x = this->nodes_x[center];
 
-            if( x > center_node->x )
+            if( x > center_x )
             {
                 p = center;
             }
-            else if( x < center_node->x )
+            else if( x < center_x )
             {
                 q = center;
             }
             else
             {
-                center_node->index = center;
-                this->nodes[center+1]->index = center+1;
-
-                return std::pair<SplineNode*,SplineNode*>(center_node,this->nodes[center+1]);
+                return std::pair<size_t,size_t>(center,center+1);
             }
 
             center = (p+q)/2;
         }
 
-        SplineNode* left = this->nodes[center];
-        left->index = p;
-
-        SplineNode* right = this->nodes[center+1];
-        right->index = q;
-
-        return std::pair<SplineNode*,SplineNode*>(left,right);
+        return std::pair<size_t,size_t>(p,q);
 
     }
 
-    void Spline::remove_redudant_points()
+    template<class Storage>
+    void BasicSpline<Storage>::remove_redudant_points()
     {
-        auto iter = this->nodes.begin();
-        
-        while( (iter+1) != this->nodes.end() )
+        if( this->count == 0 )
         {
-            auto next_iter = iter + 1;
+            return;
+        }
 
-            number dx = (*iter)->x-(*next_iter)->x;
+        size_t last = 0;
 
-            number dy = (*iter)->y-(*next_iter)->y;
+        for(size_t i=1;i<this->count;++i)
+        {
+            number dx = static_cast<number>(this->nodes_x[last]) - static_cast<number>(this->nodes_x[i]);
+
+            number dy = static_cast<number>(this->nodes_y[last]) - static_cast<number>(this->nodes_y[i]);
 
             number distance = dx*dx + dy*dy;
 
             if( distance <= 0.000001f )
             {
-                SplineNode* node = (*next_iter);
-
-                delete node;
-
-                this->nodes.erase(next_iter);
+                continue;
             }
 
-            iter++;
+            last++;
+
+            this->nodes_x[last] = this->nodes_x[i];
+            this->nodes_y[last] = this->nodes_y[i];
         }
+
+        this->count = last + 1;
     }
 
-    void Spline::smooth_the_spline(const size_t chunk_size)
+    template<class Storage>
+    void BasicSpline<Storage>::smooth_the_spline(const size_t chunk_size)
     {
-        auto iter = this->nodes.begin();
-
-        std::vector<SplineNode*> new_nodes;
-        
         size_t i = 0;
 
+        size_t new_count = 0;
+
         number x = 0;
         number y = 0;
 
-        while( iter!= this->nodes.end() )
+        for(size_t n=0;n<this->count;++n)
         {
-            SplineNode* node = (*iter);
-
-            x += node->x;
-            y += node->y;
+            x += this->nodes_x[n];
+            y += this->nodes_y[n];
 
             i++;
 
-            iter++;
-
             if( i == chunk_size )
             {
-                SplineNode* mean_node = new SplineNode(x/chunk_size,y/chunk_size);
+                // mean nodes never overtake the nodes that are still to be read
+                this->nodes_x[new_count] = x/chunk_size;
+                this->nodes_y[new_count] = y/chunk_size;
 
-                new_nodes.push_back(mean_node);
+                new_count++;
 
                 i = 0;
 
@@ -335,30 +713,20 @@ namespace snn
 
         }
 
-        for(SplineNode* node : this->nodes)
-        {
-            delete node;
-        }
-
-        this->nodes.clear();
-
-        this->nodes = std::move(new_nodes);
+        this->count = new_count;
 
         this->sort_nodes();
 
     }
 
-    void Spline::linearization()
+    template<class Storage>
+    void BasicSpline<Storage>::linearization()
     {
-        auto iter = this->nodes.begin();
-        auto first_iter = this->nodes.begin();
-
-        std::vector<SplineNode*> new_nodes;
-
 
     }
 
-    void Spline::simplify()
+    template<class Storage>
+    void BasicSpline<Storage>::simplify()
     {
         // remove close points
         this->remove_redudant_points();
@@ -372,57 +740,58 @@ namespace snn
     /*!
         Activation function.
     */
-    number Spline::fire(number x)
+    template<class Storage>
+    number BasicSpline<Storage>::fire(number x) const
     {
-        if( nodes.size() == 0 )
+        if( this->count == 0 )
         {
             return 0.f;
         }
 
-        std::pair<SplineNode*,SplineNode*> nodes = this->search(x);
+        std::pair<size_t,size_t> nodes = this->search(x);
 
-        if( !nodes.first && !nodes.second )
+        if( nodes.second == SPLINE_NO_NODE )
         {
-            return 0.f;
+            return this->nodes_x[nodes.first] == x ? static_cast<number>(this->nodes_y[nodes.first]) : 0;
         }
 
-        if( nodes.first && !nodes.second )
+        if( nodes.first == SPLINE_NO_NODE )
         {
-            return nodes.first->x == x ? nodes.first->y : 0;
+            return this->nodes_x[nodes.second] == x ? static_cast<number>(this->nodes_y[nodes.second]) : 0;
         }
 
-        if( !nodes.first && nodes.second )
-        {
-            return nodes.second->x == x ? nodes.second->y : 0;
-        }
+        const number left_x = this->nodes_x[nodes.first];
+        const number right_x = this->nodes_x[nodes.second];
+
+        const number left_y = this->nodes_y[nodes.first];
+        const number right_y = this->nodes_y[nodes.second];
 
-        if( nodes.first->x == nodes.second->x )
+        if( left_x == right_x )
         {
-            return nodes.first->x == x ? nodes.first->y : 0; 
-        }   
+            return left_x == x ? left_y : 0;
+        }
 
         // let's use linear approximation
 
-        number _x = x - nodes.first->x;
-
-        SplineNode* left = nodes.first;
-        SplineNode* right = nodes.second;
+        number _x = x - left_x;
 
-        number a = ( right->y - left->y )/( right->x - left->x );
+        number a = ( right_y - left_y )/( right_x - left_x );
 
-        return a*_x + left->y;
+        return a*_x + left_y;
 
     }
 
 
-    void Spline::printInfo(std::ostream& out)
+    template<class Storage>
+    void BasicSpline<Storage>::printInfo(std::ostream& out)
     {
-        out<<"Node count: "<<this->nodes.size()<<std::endl;
+        out<<"Node count: "<<this->count<<std::endl;
     }
 
-    void Spline::save(std::ostream& out) const
+    template<class Storage>
+    void BasicSpline<Storage>::save(std::ostream& out) const
     {
-        uint32_t len = this->nodes.size();
+        uint32_t len = this->count;
 
         char len_buffer[4];
 
@@ -435,21 +804,22 @@ namespace snn
 
         char buffer[buffor_size];
 
-        for( SplineNode* node : this->nodes )
+        for(size_t i=0;i<this->count;++i)
         {
-            node->serialize(buffer);
+            SplineNode(this->nodes_x[i],this->nodes_y[i]).serialize(buffer);
 
             out.write(buffer,buffor_size);
         }
     }
 
-    void Spline::load(std::istream& in)
+    template<class Storage>
+    void BasicSpline<Storage>::load(std::istream& in)
     {
         char len_buffer[4];
 
         in.read(len_buffer,4);
 
-        uint32_t nodes_to_read;        
+        uint32_t nodes_to_read;
 
         memmove((char*)&nodes_to_read,len_buffer,4);
 
@@ -457,27 +827,37 @@ namespace snn
 
         char buffer[buffor_size];
 
+        // loaded nodes replace the current ones
+        this->count = 0;
+
+        this->reserve(nodes_to_read);
+
+        SplineNode node;
+
         for(uint32_t i=0;i<nodes_to_read;++i)
         {
             in.read(buffer,buffor_size);
 
-            SplineNode* node = new SplineNode();
+            node.deserialize(buffer);
 
-            node->deserialize(buffer);
+            this->nodes_x[this->count] = node.x;
+            this->nodes_y[this->count] = node.y;
 
-            this->nodes.push_back(node);
+            this->count++;
         }
 
     }
 
-    Spline::~Spline()
+    template<class Storage>
+    BasicSpline<Storage>::~BasicSpline()
     {
-        for( SplineNode* node : this->nodes )
+        if( this->nodes_x )
         {
-            delete node;
+            this->free_nodes(this->nodes_x,this->capacity);
+            this->free_nodes(this->nodes_y,this->capacity);
         }
 
-        this->nodes.clear();
+        this->count = 0;
     }
 
-}
\ No newline at end of file
+}
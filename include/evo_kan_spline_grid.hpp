@@ -0,0 +1,280 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <misc.hpp>
+
+#include <evo_kan_spline_node.hpp>
+#include <arena.hpp>
+#include <config.hpp>
+
+namespace snn
+{
+
+    /*!
+        A read-only spline used for inference of trained EVO KAN models.
+
+        Other spline is resampled with compile() onto Resolution cells of equal width,
+        each cell keeps slope and intercept of its line. Evaluation is one index
+        computation and one multiply-add, without any search. Outside of range of
+        source nodes it returns 0, like source splines do.
+
+        It can be used as SplineClass of EvoKan and EvoKanLayer, fit does nothing.
+    */
+    template<size_t Resolution = SPLINE_GRID_RESOLUTION>
+    class SplineGrid
+    {
+        static_assert(Resolution > 0,"SplineGrid requires at least one cell");
+
+        template<class>
+        friend struct SplineKernel;
+
+        protected:
+
+        // slope and intercept of each cell lie next to each other, so fire reads one line
+        struct Line
+        {
+            number slope;
+            number intercept;
+        };
+
+        alignas(SPLINE_NODE_ALIGNMENT) Line lines[Resolution];
+
+        number x_min;
+
+        number x_max;
+
+        number inv_step;
+
+        void build(const number* values);
+
+        public:
+
+        static constexpr bool read_only = true;
+
+        SplineGrid( size_t initial_size = 8 , Arena* arena = nullptr );
+
+        template<class SplineClass>
+        number compile(const SplineClass& source);
+
+        void fit(number x,number y)
+        {
+
+        }
+
+        void fit(number x,number y,std::pair<size_t,size_t> nodes)
+        {
+
+        }
+
+        void fit_batch(const number* x,const number* y,size_t count)
+        {
+
+        }
+
+        void simplify()
+        {
+
+        }
+
+        number fire(number x) const
+        {
+            if( x < this->x_min || x > this->x_max )
+            {
+                return 0.f;
+            }
+
+            const size_t id = std::min<size_t>(static_cast<size_t>( ( x - this->x_min )*this->inv_step ),Resolution-1);
+
+            return this->lines[id].slope*x + this->lines[id].intercept;
+        }
+
+        void printInfo(std::ostream& out);
+
+        void save(std::ostream& out) const;
+
+        void load(std::istream& in);
+
+    };
+
+
+    template<size_t Resolution>
+    SplineGrid<Resolution>::SplineGrid( size_t initial_size , Arena* arena )
+    {
+        this->x_min = DEF_X_LEFT;
+        this->x_max = DEF_X_RIGHT;
+
+        this->inv_step = Resolution/( this->x_max - this->x_min );
+
+        for(size_t i=0;i<Resolution;++i)
+        {
+            this->lines[i].slope = 0.f;
+            this->lines[i].intercept = 0.f;
+        }
+    }
+
+    /*!
+        Compute lines of cells from values at Resolution+1 grid points between
+        x_min and x_max.
+    */
+    template<size_t Resolution>
+    void SplineGrid<Resolution>::build(const number* values)
+    {
+        const number step = ( this->x_max - this->x_min )/Resolution;
+
+        this->inv_step = step > 0.f ? 1.f/step : 0.f;
+
+        for(size_t i=0;i<Resolution;++i)
+        {
+            const number x = this->x_min + step*i;
+
+            this->lines[i].slope = step > 0.f ? ( values[i+1] - values[i] )/step : 0.f;
+
+            this->lines[i].intercept = values[i] - this->lines[i].slope*x;
+        }
+    }
+
+    /*!
+        Resample source spline, it needs fire, get_x and length. Returns maximal
+        absolute difference between source and grid, checked at every source node
+        and grid point, where error of linear resampling is the biggest.
+    */
+    template<size_t Resolution>
+    template<class SplineClass>
+    number SplineGrid<Resolution>::compile(const SplineClass& source)
+    {
+        const auto* nodes_x = source.get_x();
+
+        const size_t count = source.length();
+
+        number values[Resolution+1];
+
+        if( count < 2 )
+        {
+            // nothing to interpolate, only zero is left
+            this->x_min = 0.f;
+            this->x_max = -1.f;
+
+            std::fill(values,values+Resolution+1,0.f);
+
+            this->build(values);
+
+            return count == 1 ? abs(source.fire(nodes_x[0])) : 0.f;
+        }
+
+        this->x_min = nodes_x[0];
+        this->x_max = nodes_x[count-1];
+
+        const number step = ( this->x_max - this->x_min )/Resolution;
+
+        for(size_t i=0;i<Resolution;++i)
+        {
+            values[i] = source.fire(this->x_min + step*i);
+        }
+
+        values[Resolution] = source.fire(this->x_max);
+
+        this->build(values);
+
+        number error = 0.f;
+
+        for(size_t i=0;i<count;++i)
+        {
+            error = std::max<number>(error,abs( source.fire(nodes_x[i]) - this->fire(nodes_x[i]) ));
+        }
+
+        for(size_t i=0;i<=Resolution;++i)
+        {
+            const number x = std::min<number>(this->x_min + step*i,this->x_max);
+
+            error = std::max<number>(error,abs( source.fire(x) - this->fire(x) ));
+        }
+
+        return error;
+    }
+
+    template<size_t Resolution>
+    void SplineGrid<Resolution>::printInfo(std::ostream& out)
+    {
+        out<<"Grid cells: "<<Resolution<<" range: "<<this->x_min<<" "<<this->x_max<<std::endl;
+    }
+
+    /*!
+        Grid is saved as Resolution+1 nodes, the same way as Spline saves its nodes,
+        so compiled model can be loaded back into Spline.
+    */
+    template<size_t Resolution>
+    void SplineGrid<Resolution>::save(std::ostream& out) const
+    {
+        uint32_t len = Resolution+1;
+
+        char len_buffer[4];
+
+        memmove(len_buffer,(char*)&len,4);
+
+        out.write(len_buffer,4);
+
+        constexpr size_t buffor_size = SplineNode::size_for_serialization();
+
+        char buffer[buffor_size];
+
+        const number step = ( this->x_max - this->x_min )/Resolution;
+
+        for(size_t i=0;i<=Resolution;++i)
+        {
+            const number x = i == Resolution ? this->x_max : this->x_min + step*i;
+
+            const size_t id = std::min<size_t>(i,Resolution-1);
+
+            SplineNode(x,this->lines[id].slope*x + this->lines[id].intercept).serialize(buffer);
+
+            out.write(buffer,buffor_size);
+        }
+    }
+
+    template<size_t Resolution>
+    void SplineGrid<Resolution>::load(std::istream& in)
+    {
+        char len_buffer[4];
+
+        in.read(len_buffer,4);
+
+        uint32_t nodes_to_read;
+
+        memmove((char*)&nodes_to_read,len_buffer,4);
+
+        if( nodes_to_read != Resolution+1 )
+        {
+            throw std::runtime_error("Spline grid size mismatch in byte stream!!!");
+        }
+
+        constexpr size_t buffor_size = SplineNode::size_for_serialization();
+
+        char buffer[buffor_size];
+
+        SplineNode node;
+
+        number values[Resolution+1];
+
+        for(uint32_t i=0;i<nodes_to_read;++i)
+        {
+            in.read(buffer,buffor_size);
+
+            node.deserialize(buffer);
+
+            if( i == 0 )
+            {
+                this->x_min = node.x;
+            }
+
+            this->x_max = node.x;
+
+            values[i] = node.y;
+        }
+
+        this->build(values);
+    }
+
+}
@@ -4,6 +4,9 @@
 
 namespace snn
 {
+    // index returned by spline search when there is no node on that side of the point
+    #define SPLINE_NO_NODE (static_cast<size_t>(-1))
+
     /*!
         A struct that represents point in spline curve with x and y coordinats, it also
         support basic serialization and deserialization.
@@ -12,7 +15,6 @@ namespace snn
     {
         number x;
         number y;
-        size_t index;
 
         SplineNode(){}
 
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#include <misc.hpp>
+
+#include <evo_kan_spline_node.hpp>
+#include <arena.hpp>
+#include <config.hpp>
+
+namespace snn
+{
+
+    /*!
+        A read-only spline with values stored as 8 or 16 bit integers, for inference
+        of trained EVO KAN models on machines with small caches.
+
+        Like SplineGrid it is made with compile() from other spline, resampled at
+        Resolution+1 points spaced evenly between x_min and x_max. Position of x is
+        a fixed point number, integer part is index of cell and fraction is weight of
+        its right point, so no x is stored at all. Values are kept as Value integers
+        with one scale and offset for the whole spline, value of point j is
+        offset + scale*values[j].
+
+        Float splines stay the master copy used for training, this one is only
+        compiled from them. fit does nothing.
+    */
+    template<size_t Resolution = SPLINE_QUANTIZED_RESOLUTION,class Value = int8_t>
+    class SplineQuantized
+    {
+        static_assert(Resolution > 0,"SplineQuantized requires at least one cell");
+
+        static_assert(std::is_same_v<Value,int8_t> || std::is_same_v<Value,int16_t>,"SplineQuantized supports only int8_t and int16_t values");
+
+        template<class>
+        friend struct SplineKernel;
+
+        protected:
+
+        // biggest magnitude of stored value, range is symmetric around offset
+        static constexpr number value_limit = std::numeric_limits<Value>::max();
+
+        number x_min;
+
+        number x_max;
+
+        number inv_step;
+
+        number scale;
+
+        number offset;
+
+        // extra values at the end let 32 bit loads of last cell stay inside of spline
+        Value values[Resolution + 1 + ( sizeof(int32_t) - sizeof(Value) )/sizeof(Value)];
+
+        void build(const number* points);
+
+        public:
+
+        static constexpr bool read_only = true;
+
+        SplineQuantized( size_t initial_size = 8 , Arena* arena = nullptr );
+
+        template<class SplineClass>
+        number compile(const SplineClass& source);
+
+        void fit(number x,number y)
+        {
+
+        }
+
+        void fit(number x,number y,std::pair<size_t,size_t> nodes)
+        {
+
+        }
+
+        void fit_batch(const number* x,const number* y,size_t count)
+        {
+
+        }
+
+        void simplify()
+        {
+
+        }
+
+        number fire(number x) const
+        {
+            if( x < this->x_min || x > this->x_max )
+            {
+                return 0.f;
+            }
+
+            const number position = ( x - this->x_min )*this->inv_step;
+
+            const size_t id = std::min<size_t>(static_cast<size_t>(position),Resolution-1);
+
+            const number t = position - static_cast<number>(id);
+
+            const number left = this->values[id];
+            const number right = this->values[id+1];
+
+            return this->offset + this->scale*( left + t*( right - left ) );
+        }
+
+        void printInfo(std::ostream& out);
+
+        void save(std::ostream& out) const;
+
+        void load(std::istream& in);
+
+    };
+
+
+    template<size_t Resolution,class Value>
+    SplineQuantized<Resolution,Value>::SplineQuantized( size_t initial_size , Arena* arena )
+    {
+        this->x_min = DEF_X_LEFT;
+        this->x_max = DEF_X_RIGHT;
+
+        this->inv_step = Resolution/( this->x_max - this->x_min );
+
+        this->scale = 0.f;
+        this->offset = 0.f;
+
+        std::fill(std::begin(this->values),std::end(this->values),0);
+    }
+
+    /*!
+        Quantize values at Resolution+1 grid points between x_min and x_max.
+    */
+    template<size_t Resolution,class Value>
+    void SplineQuantized<Resolution,Value>::build(const number* points)
+    {
+        const number step = ( this->x_max - this->x_min )/Resolution;
+
+        this->inv_step = step > 0.f ? 1.f/step : 0.f;
+
+        const auto [low,high] = std::minmax_element(points,points+Resolution+1);
+
+        this->offset = ( *low + *high )*0.5f;
+
+        this->scale = ( *high - *low )*0.5f/value_limit;
+
+        const number inv_scale = this->scale > 0.f ? 1.f/this->scale : 0.f;
+
+        std::fill(std::begin(this->values),std::end(this->values),0);
+
+        for(size_t i=0;i<=Resolution;++i)
+        {
+            const number q = std::round(( points[i] - this->offset )*inv_scale);
+
+            this->values[i] = static_cast<Value>(std::clamp<number>(q,-value_limit,value_limit));
+        }
+    }
+
+    /*!
+        Resample and quantize source spline, it needs fire, get_x and length. Returns
+        maximal absolute difference between source and quantized spline, checked at
+        every source node and grid point.
+    */
+    template<size_t Resolution,class Value>
+    template<class SplineClass>
+    number SplineQuantized<Resolution,Value>::compile(const SplineClass& source)
+    {
+        const auto* nodes_x = source.get_x();
+
+        const size_t count = source.length();
+
+        number points[Resolution+1];
+
+        if( count < 2 )
+        {
+            // nothing to interpolate, only zero is left
+            this->x_min = 0.f;
+            this->x_max = -1.f;
+
+            std::fill(points,points+Resolution+1,0.f);
+
+            this->build(points);
+
+            return count == 1 ? abs(source.fire(nodes_x[0])) : 0.f;
+        }
+
+        this->x_min = nodes_x[0];
+        this->x_max = nodes_x[count-1];
+
+        const number step = ( this->x_max - this->x_min )/Resolution;
+
+        for(size_t i=0;i<Resolution;++i)
+        {
+            points[i] = source.fire(this->x_min + step*i);
+        }
+
+        points[Resolution] = source.fire(this->x_max);
+
+        this->build(points);
+
+        number error = 0.f;
+
+        for(size_t i=0;i<count;++i)
+        {
+            error = std::max<number>(error,abs( source.fire(nodes_x[i]) - this->fire(nodes_x[i]) ));
+        }
+
+        for(size_t i=0;i<=Resolution;++i)
+        {
+            const number x = std::min<number>(this->x_min + step*i,this->x_max);
+
+            error = std::max<number>(error,abs( source.fire(x) - this->fire(x) ));
+        }
+
+        return error;
+    }
+
+    template<size_t Resolution,class Value>
+    void SplineQuantized<Resolution,Value>::printInfo(std::ostream& out)
+    {
+        out<<"Quantized grid cells: "<<Resolution<<" value bits: "<<sizeof(Value)*8<<" range: "<<this->x_min<<" "<<this->x_max<<std::endl;
+    }
+
+    /*!
+        Saved as Resolution+1 dequantized nodes, the same way as Spline saves its nodes.
+    */
+    template<size_t Resolution,class Value>
+    void SplineQuantized<Resolution,Value>::save(std::ostream& out) const
+    {
+        uint32_t len = Resolution+1;
+
+        char len_buffer[4];
+
+        memmove(len_buffer,(char*)&len,4);
+
+        out.write(len_buffer,4);
+
+        constexpr size_t buffor_size = SplineNode::size_for_serialization();
+
+        char buffer[buffor_size];
+
+        const number step = ( this->x_max - this->x_min )/Resolution;
+
+        for(size_t i=0;i<=Resolution;++i)
+        {
+            const number x = i == Resolution ? this->x_max : this->x_min + step*i;
+
+            SplineNode(x,this->offset + this->scale*this->values[i]).serialize(buffer);
+
+            out.write(buffer,buffor_size);
+        }
+    }
+
+    template<size_t Resolution,class Value>
+    void SplineQuantized<Resolution,Value>::load(std::istream& in)
+    {
+        char len_buffer[4];
+
+        in.read(len_buffer,4);
+
+        uint32_t nodes_to_read;
+
+        memmove((char*)&nodes_to_read,len_buffer,4);
+
+        if( nodes_to_read != Resolution+1 )
+        {
+            throw std::runtime_error("Spline grid size mismatch in byte stream!!!");
+        }
+
+        constexpr size_t buffor_size = SplineNode::size_for_serialization();
+
+        char buffer[buffor_size];
+
+        SplineNode node;
+
+        number points[Resolution+1];
+
+        for(uint32_t i=0;i<nodes_to_read;++i)
+        {
+            in.read(buffer,buffor_size);
+
+            node.deserialize(buffer);
+
+            if( i == 0 )
+            {
+                this->x_min = node.x;
+            }
+
+            this->x_max = node.x;
+
+            points[i] = node.y;
+        }
+
+        this->build(points);
+    }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace snn
+{
+    /*!
+        16 bit number types used only to keep values in memory, all math is done after
+        conversion to number. They halve memory traffic of splines, at cost of
+        precision, half keeps about 3 decimal digits and bfloat16 about 2.
+    */
+
+#if defined(__FLT16_MAX__)
+
+    // IEEE half precision, converted with F16C instructions where available
+    typedef _Float16 half;
+
+#endif
+
+    /*!
+        Upper half of float, with the same range as float. Conversion rounds to nearest
+        even, so it needs only integer instructions.
+    */
+    struct bfloat16
+    {
+        uint16_t bits;
+
+        bfloat16() = default;
+
+        bfloat16(float value)
+        {
+            uint32_t word;
+
+            memcpy(&word,&value,sizeof(word));
+
+            word += 0x7FFF + ( ( word >> 16 ) & 1 );
+
+            this->bits = word >> 16;
+        }
+
+        operator float() const
+        {
+            const uint32_t word = static_cast<uint32_t>(this->bits) << 16;
+
+            float value;
+
+            memcpy(&value,&word,sizeof(value));
+
+            return value;
+        }
+
+        bfloat16& operator+=(float value)
+        {
+            return *this = static_cast<float>(*this) + value;
+        }
+
+        bfloat16& operator-=(float value)
+        {
+            return *this = static_cast<float>(*this) - value;
+        }
+
+    };
+
+}
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <random>
-
 #include "initializer.hpp"
 
+#include "rng.hpp"
+
 #include "config.hpp"
 
 namespace snn
@@ -11,25 +11,11 @@ namespace snn
     template<number mean,number std>
     class GaussInit
     {
-
-        std::normal_distribution<number> gauss;
-
-        std::mt19937 gen; 
-
         public:
 
-        GaussInit()
-        {
-            std::random_device rd;
-
-            this->gen = std::mt19937(rd());
-
-            this->gauss = std::normal_distribution<number>(mean,std);  
-        }
-
         number init()
         {
-            return this->gauss(this->gen);
+            return random_normal(mean,std);
         }
     };
-}
\ No newline at end of file
+}
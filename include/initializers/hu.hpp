@@ -1,10 +1,11 @@
 #pragma once
 
-#include <random>
 #include <cmath>
 
 #include "initializer.hpp"
 
+#include "rng.hpp"
+
 #include "config.hpp"
 
 namespace snn
@@ -12,26 +13,12 @@ namespace snn
     template<size_t inputSize>
     class HuInit
     {
-
-        std::mt19937 gen; 
-
-        std::normal_distribution<number> global;
-
         public:
 
-        HuInit()
-        {
-            std::random_device rd;
-
-            this->gen = std::mt19937(rd());
-
-            this->global = std::normal_distribution<number>(0,std::sqrt(2.f/static_cast<number>(inputSize)));
-        }
-
         number init()
         {
-            return this->global(this->gen);
+            return random_normal(0.f,std::sqrt(2.f/static_cast<number>(inputSize)));
         }
 
     };
-}
\ No newline at end of file
+}
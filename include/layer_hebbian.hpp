@@ -5,7 +5,6 @@
 #include <fstream>
 #include <algorithm>
 #include <string>
-#include <thread>
 #include <deque>
 
 #include "block_kac.hpp"
@@ -26,6 +25,8 @@
 
 #include "layer_counter.hpp"
 
+#include "thread_pool.hpp"
+
 #include "initializers/hu.hpp"
 #include "initializers/gauss.hpp"
 #include "initializers/uniform.hpp"
@@ -145,11 +146,11 @@ namespace snn
             
         }
 
-        static void fire_parraler(snn::SIMDVectorLite<inputSize> * blocks,number *biases,const SIMDVectorLite<inputSize>& input,SIMDVectorLite<N> &output,size_t start,size_t end)
+        static void fire_parraler(snn::SIMDVectorLite<inputSize> * blocks,number *biases,const SIMDVectorLite<inputSize>& input,number* output,size_t start,size_t end)
         {
             for(;start<end;++start)
             {
-                output[start] = (blocks[start]*input).reduce();//+biases[start];
+                output[start] = blocks[start].dot(input);//+biases[start];
             }
         }
 
@@ -157,34 +158,26 @@ namespace snn
         {
             SIMDVectorLite<N> output(0);
 
-            std::thread threads[USED_THREADS];
+            // every task writes to its own range of plain array
+            number results[N];
 
-            size_t min = 0;
+            ThreadPool& pool = ThreadPool::global();
 
-            size_t worker_count = USED_THREADS;
+            const size_t worker_count = std::min<size_t>(pool.concurrency(),N);
 
-            if( worker_count > N )
-            {
-                worker_count = N;   
-            }
+            pool.parallel(worker_count,[&](size_t i){
 
-            const size_t step = N/worker_count;
+                const size_t start = (i*N)/worker_count;
 
-            size_t max = step; 
+                const size_t end = ((i+1)*N)/worker_count;
 
+                fire_parraler(this->blocks,this->biases,input,results,start,end);
 
-            for(size_t i=0;i<worker_count;++i)
-            {
-                threads[i] = std::thread(fire_parraler,this->blocks,this->biases,std::cref(input),std::ref(output),min,max);
+            });
 
-                min = max;
-                
-                max = ( 1 - ( i/(worker_count-1) ) )*( max + step ) + ( i/(worker_count-1) )*N;
-            }
-
-            for(size_t i=0;i<worker_count;++i)
+            for(size_t i=0;i<N;++i)
             {
-                threads[i].join();
+                output[i] = results[i];
             }
 
 
@@ -5,7 +5,6 @@
 #include <fstream>
 #include <algorithm>
 #include <string>
-#include <thread>
 #include <deque>
 
 #include "block_kac.hpp"
@@ -26,6 +25,10 @@
 
 #include "layer_counter.hpp"
 
+#include "thread_pool.hpp"
+
+#include "rng.hpp"
+
 #include "initializers/hu.hpp"
 #include "initializers/gauss.hpp"
 /*
@@ -39,14 +42,22 @@ namespace snn
     template<size_t inputSize,size_t N,size_t Populus,class Activation = Linear,class weight_initializer = GaussInit<(number)0.f,(number)0.01f>>
     class LayerKAC : public Layer
     { 
-        const uint32_t LAYER_KAC_ID = 2148;
+        // populations are stored as matrices with bias row since 2149
+        const uint32_t LAYER_KAC_ID = 2149;
 
         BlockKAC<inputSize,Populus,weight_initializer>* blocks;
 
-        std::uniform_real_distribution<double> uniform;
-
         size_t id;
 
+        // key of RandomScope of blocks is (seed, random_layer, block, step)
+        uint64_t seed;
+
+        bool fixed_seed;
+
+        uint64_t random_layer;
+
+        uint64_t step;
+
         struct metadata
         {
             uint32_t id;
@@ -55,15 +66,48 @@ namespace snn
             size_t population_size;
         };
         
-        public:
+        uint64_t layer_seed() const
+        {
+            return this->fixed_seed ? this->seed : random_seed();
+        }
 
-        LayerKAC()
+        void init(uint64_t random_layer)
         {
             this->blocks = new BlockKAC<inputSize,Populus,weight_initializer>[N];
 
             this->id = LayerCounter::LayerIDCounter++ ;
 
-            this->uniform=std::uniform_real_distribution<double>(0.f,1.f);
+            this->random_layer = random_layer;
+
+            this->step = 0;
+        }
+
+        public:
+
+        /*!
+            Random numbers of layer follow global seed, see Arbiter::set_seed.
+        */
+        LayerKAC()
+        {
+            this->seed = 0;
+
+            this->fixed_seed = false;
+
+            this->init(next_random_layer());
+        }
+
+        /*!
+            Random numbers of layer depend only on seed, layer and on number of steps done,
+            not on layers created before. Layers of one model sharing a seed need different
+            layer ids.
+        */
+        explicit LayerKAC(uint64_t seed,uint64_t layer = 0)
+        {
+            this->seed = seed;
+
+            this->fixed_seed = true;
+
+            this->init(layer);
         }
 
         void setup()
@@ -71,10 +115,14 @@ namespace snn
 
             for(size_t i=0;i<N;++i)
             {
+                RandomScope scope(this->layer_seed(),this->random_layer,i,this->step);
+
                 // this->blocks[i]= BlockKAC<inputSize,Populus>();
                 this->blocks[i].setup();
                 // this->blocks.back().chooseWorkers();
             }
+
+            this->step++;
         }
 
         void applyReward(long double reward)
@@ -88,20 +136,39 @@ namespace snn
             }
         }
 
+        /*!
+            Blocks evolve in parallel, each draws from its own RandomScope, so result
+            doesn't depend on amount of threads.
+        */
         void shuttle()
         {
-            
-            for(size_t i=0;i<N;++i)
-            {
-                this->blocks[i].chooseWorkers();
-            }   
+            ThreadPool& pool = ThreadPool::global();
+
+            const size_t worker_count = std::min<size_t>(pool.concurrency(),N);
+
+            const uint64_t seed = this->layer_seed();
+
+            pool.parallel(worker_count,[&](size_t w){
+
+                const size_t end = ((w+1)*N)/worker_count;
+
+                for(size_t i=(w*N)/worker_count;i<end;++i)
+                {
+                    RandomScope scope(seed,this->random_layer,i,this->step);
+
+                    this->blocks[i].chooseWorkers();
+                }
+
+            });
+
+            this->step++;
         }
 
-        static void fire_parraler(BlockKAC<inputSize,Populus,weight_initializer>* blocks,const SIMDVectorLite<inputSize>& input,SIMDVectorLite<N> &output,size_t start,size_t end)
+        static void fire_parraler(BlockKAC<inputSize,Populus,weight_initializer>* blocks,const SIMDVectorLite<inputSize>& input,number* output,size_t start,size_t end)
         {
             for(;start<end;++start)
             {
-                output[start] = blocks[start].fire(input); 
+                output[start] = blocks[start].fire(input);
             }
         }
 
@@ -109,34 +176,26 @@ namespace snn
         {
             SIMDVectorLite<N> output(0);
 
-            std::thread threads[USED_THREADS];
+            // every task writes to its own range of plain array
+            number results[N];
 
-            size_t min = 0;
+            ThreadPool& pool = ThreadPool::global();
 
-            size_t worker_count = USED_THREADS;
+            const size_t worker_count = std::min<size_t>(pool.concurrency(),N);
 
-            if( worker_count > N )
-            {
-                worker_count = N;   
-            }
+            pool.parallel(worker_count,[&](size_t i){
 
-            const size_t step = N/worker_count;
+                const size_t start = (i*N)/worker_count;
 
-            size_t max = step; 
+                const size_t end = ((i+1)*N)/worker_count;
 
+                fire_parraler(this->blocks,input,results,start,end);
 
-            for(size_t i=0;i<worker_count;++i)
-            {
-                threads[i] = std::thread(fire_parraler,this->blocks,std::cref(input),std::ref(output),min,max);
+            });
 
-                min = max;
-                
-                max = ( 1 - ( i/(worker_count-1) ) )*( max + step ) + ( i/(worker_count-1) )*N;
-            }
-
-            for(size_t i=0;i<worker_count;++i)
+            for(size_t i=0;i<N;++i)
             {
-                threads[i].join();
+                output[i] = results[i];
             }
 
 
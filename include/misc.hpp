@@ -6,6 +6,8 @@
 #include <climits>
 #include "simd_vector.hpp"
 #include "simd_vector_lite.hpp"
+#include "simd_math.hpp"
+#include "rng.hpp"
 
 #include "config.hpp"
 
@@ -59,18 +61,36 @@ namespace snn
         return static_cast<T>(std::ldexp(static_cast<T>(mant) / std::numeric_limits<std::int64_t>::max() ,exp));
     }
 
-    size_t get_action_id(const snn::SIMDVector& actions)
+    /*!
+        Fraction of distance to target covered by hits nudges of given rate,
+        1 - (1-rate)^hits computed by squaring.
+    */
+    inline number nudge_rate(number rate,uint32_t hits)
     {
-        std::random_device rd; 
+        number keep = 1.f;
+
+        number base = 1.f - rate;
+
+        while( hits > 0 )
+        {
+            if( hits & 1 )
+            {
+                keep *= base;
+            }
 
-        // Mersenne twister PRNG, initialized with seed from previous random device instance
-        std::mt19937 gen(rd()); 
+            base *= base;
 
-        std::uniform_real_distribution<number> uniform_chooser(0.f,1.f);
+            hits >>= 1;
+        }
 
+        return 1.f - keep;
+    }
+
+    size_t get_action_id(const snn::SIMDVector& actions)
+    {
         number shift = 0;
 
-        number choose = uniform_chooser(gen);
+        number choose = random_uniform();
 
         size_t action_id = 0;
 
@@ -91,16 +111,9 @@ namespace snn
     template<size_t Size>
     size_t get_action_id(const snn::SIMDVectorLite<Size>& actions)
     {
-        std::random_device rd; 
-
-        // Mersenne twister PRNG, initialized with seed from previous random device instance
-        std::mt19937 gen(rd()); 
-
-        std::uniform_real_distribution<number> uniform_chooser(0.f,1.f);
-
         number shift = 0;
 
-        number choose = uniform_chooser(gen);
+        number choose = random_uniform();
 
         size_t action_id = 0;
 
@@ -269,41 +282,159 @@ namespace snn
             return out;
         }
 
+        /*!
+            Element wise exp, log, tanh, sigmoid and SiLU with polynomial kernels from
+            simd_math.hpp, errors are listed there.
+        */
         SIMDVector exp(const SIMDVector& vec)
         {
-            size_t n=1;
+            return vec.map([](const auto& block){ return simd_exp(block); });
+        }
 
-            SIMDVector x1=vec;
+        template<size_t Size>
+        SIMDVectorLite<Size> exp(const SIMDVectorLite<Size>& vec)
+        {
+            return vec.map([](const auto& block){ return simd_exp(block); });
+        }
 
-            SIMDVector sum=x1+1;
+        SIMDVector log(const SIMDVector& vec)
+        {
+            return vec.map([](const auto& block){ return simd_log(block); });
+        }
 
-            while(n < 20)
-            {
-                x1=x1*(vec/(++n));
-                sum+=x1;
-            };
+        template<size_t Size>
+        SIMDVectorLite<Size> log(const SIMDVectorLite<Size>& vec)
+        {
+            return vec.map([](const auto& block){ return simd_log(block); });
+        }
 
-            return sum;
-            
+        SIMDVector tanh(const SIMDVector& vec)
+        {
+            return vec.map([](const auto& block){ return simd_tanh(block); });
         }
 
         template<size_t Size>
-        SIMDVectorLite<Size> exp(const SIMDVectorLite<Size>& vec)
+        SIMDVectorLite<Size> tanh(const SIMDVectorLite<Size>& vec)
+        {
+            return vec.map([](const auto& block){ return simd_tanh(block); });
+        }
+
+        SIMDVector sigmoid(const SIMDVector& vec)
+        {
+            return vec.map([](const auto& block){ return simd_sigmoid(block); });
+        }
+
+        template<size_t Size>
+        SIMDVectorLite<Size> sigmoid(const SIMDVectorLite<Size>& vec)
+        {
+            return vec.map([](const auto& block){ return simd_sigmoid(block); });
+        }
+
+        SIMDVector silu(const SIMDVector& vec)
+        {
+            return vec.map([](const auto& block){ return simd_silu(block); });
+        }
+
+        template<size_t Size>
+        SIMDVectorLite<Size> silu(const SIMDVectorLite<Size>& vec)
+        {
+            return vec.map([](const auto& block){ return simd_silu(block); });
+        }
+
+        /*!
+            Softmax with the biggest element subtracted before exp, so it neither
+            overflows for big inputs nor gives 0/0 for very negative ones.
+        */
+        SIMDVector softmax(const SIMDVector& vec)
+        {
+            const number max = vec.max();
+
+            SIMDVector output = vec.map([max](const auto& block){ return simd_exp(block - max); });
+
+            output *= 1.f/output.reduce();
+
+            return output;
+        }
+
+        template<size_t Size>
+        SIMDVectorLite<Size> softmax(const SIMDVectorLite<Size>& vec)
+        {
+            const number max = vec.max();
+
+            SIMDVectorLite<Size> output = vec.map([max](const auto& block){ return simd_exp(block - max); });
+
+            output *= 1.f/output.reduce();
+
+            return output;
+        }
+
+        /*!
+            log(softmax(vec)) computed as vec - max - log(sum(exp(vec - max))), it
+            stays finite where softmax underflows to zero.
+        */
+        SIMDVector log_softmax(const SIMDVector& vec)
         {
-            size_t n=1;
+            const number max = vec.max();
 
-            SIMDVectorLite<Size> x1=vec;
+            const number sum = vec.map([max](const auto& block){ return simd_exp(block - max); }).reduce();
 
-            SIMDVectorLite<Size> sum=x1+1;
+            return vec - ( max + std::log(sum) );
+        }
 
-            while(n < 20)
+        template<size_t Size>
+        SIMDVectorLite<Size> log_softmax(const SIMDVectorLite<Size>& vec)
+        {
+            const number max = vec.max();
+
+            const number sum = vec.map_reduce([max](const auto& block){ return simd_exp(block - max); });
+
+            return vec - ( max + std::log(sum) );
+        }
+
+        /*!
+            Draw index with probability softmax(logits)[i], choose is uniform number
+            in [0,1). Weights are never normalized, choose is scaled by their sum
+            instead. Index of the last non zero weight covers rounding at the end.
+        */
+        template<class Vector>
+        size_t sample_softmax(const Vector& logits,number choose)
+        {
+            const number max = logits.max();
+
+            const Vector weights = logits.map([max](const auto& block){ return simd_exp(block - max); });
+
+            number left = choose*weights.reduce();
+
+            size_t action_id = 0;
+
+            for(size_t i=0;i<logits.size();++i)
             {
-                x1=x1*(vec/(++n));
-                sum+=x1;
-            };
+                const number weight = weights[i];
 
-            return sum;
-            
+                if( weight > 0.f )
+                {
+                    action_id = i;
+                }
+
+                left -= weight;
+
+                if( left < 0.f )
+                {
+                    break;
+                }
+            }
+
+            return action_id;
+        }
+
+        /*!
+            Softmax and sampling of get_action_id in one pass over logits, with
+            stream of current RandomScope or thread.
+        */
+        template<class Vector>
+        size_t sample_softmax(const Vector& logits)
+        {
+            return sample_softmax(logits,random_uniform());
         }
 
         SIMDVector pexp(const SIMDVector& vec)
@@ -0,0 +1,547 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <random>
+#include <experimental/simd>
+
+#include "config.hpp"
+#include "simd_math.hpp"
+
+namespace snn
+{
+    /*!
+        Step of splitmix64, it spreads seeds of generators, so close seeds give
+        unrelated streams.
+    */
+    inline uint64_t splitmix64(uint64_t& state)
+    {
+        uint64_t z = ( state += 0x9E3779B97F4A7C15ull );
+
+        z = ( z ^ ( z >> 30 ) )*0xBF58476D1CE4E5B9ull;
+        z = ( z ^ ( z >> 27 ) )*0x94D049BB133111EBull;
+
+        return z ^ ( z >> 31 );
+    }
+
+    typedef std::experimental::rebind_simd_t<uint32_t,SIMD> random_lanes_t;
+
+    /*!
+        Numbers in (0,1), never exactly 0 or 1, so log and erfinv of them stay finite.
+        They are made from upper 24 bits of random lanes.
+    */
+    inline SIMD random_lanes_uniform(const random_lanes_t& lanes)
+    {
+        const simd_int_t<SIMD> bits = std::experimental::static_simd_cast<simd_int_t<SIMD>>(lanes >> 8);
+
+        return ( std::experimental::static_simd_cast<SIMD>(bits) + 0.5f )*0x1p-24f;
+    }
+
+    /*!
+        Standard normal numbers from inverse of normal CDF, one uniform per
+        number and no rejection, tails are cut at about 5.4 sigma.
+    */
+    inline SIMD random_lanes_normal(const SIMD& uniform)
+    {
+        return 1.41421356237309505f*simd_erfinv(uniform*2.f - 1.f);
+    }
+
+    /*!
+        MAX_SIMD_VECTOR_SIZE independent xoshiro128+ generators, one per lane, stepped
+        together with SIMD integer instructions. State is 16 bytes per lane, so the
+        whole generator is smaller than a single std::mt19937. Floats are made from
+        upper 24 bits of output, which are the strong bits of xoshiro128+.
+    */
+    class SIMDRandom
+    {
+        typedef random_lanes_t lanes_t;
+
+        lanes_t s0;
+        lanes_t s1;
+        lanes_t s2;
+        lanes_t s3;
+
+        static lanes_t rotl(const lanes_t& x,int k)
+        {
+            return ( x << k ) | ( x >> ( 32 - k ) );
+        }
+
+        public:
+
+        SIMDRandom(uint64_t seed = 0,uint64_t stream = 0)
+        {
+            this->seed(seed,stream);
+        }
+
+        /*!
+            The same seed and stream always give the same numbers.
+        */
+        void seed(uint64_t seed,uint64_t stream)
+        {
+            uint64_t state = seed ^ splitmix64(stream);
+
+            uint32_t words[4][MAX_SIMD_VECTOR_SIZE];
+
+            for(size_t i=0;i<MAX_SIMD_VECTOR_SIZE;++i)
+            {
+                const uint64_t low = splitmix64(state);
+                const uint64_t high = splitmix64(state);
+
+                words[0][i] = static_cast<uint32_t>(low);
+                words[1][i] = static_cast<uint32_t>(low >> 32);
+                words[2][i] = static_cast<uint32_t>(high);
+
+                // lane state must not be all zeros
+                words[3][i] = static_cast<uint32_t>(high >> 32) | 1u;
+            }
+
+            this->s0.copy_from(words[0],std::experimental::element_aligned);
+            this->s1.copy_from(words[1],std::experimental::element_aligned);
+            this->s2.copy_from(words[2],std::experimental::element_aligned);
+            this->s3.copy_from(words[3],std::experimental::element_aligned);
+        }
+
+        lanes_t next()
+        {
+            const lanes_t output = this->s0 + this->s3;
+
+            const lanes_t t = this->s1 << 9;
+
+            this->s2 ^= this->s0;
+            this->s3 ^= this->s1;
+            this->s1 ^= this->s2;
+            this->s0 ^= this->s3;
+
+            this->s2 ^= t;
+
+            this->s3 = rotl(this->s3,11);
+
+            return output;
+        }
+
+        SIMD uniform()
+        {
+            return random_lanes_uniform(this->next());
+        }
+
+        SIMD normal()
+        {
+            return random_lanes_normal(this->uniform());
+        }
+
+    };
+
+    /*!
+        Philox4x32-10 of Salmon et al., "Parallel random numbers: as easy as 1, 2, 3".
+        Counter c is encrypted with key k in place, every counter gives four
+        independent words, so any number of a stream can be computed without
+        computing the ones before it.
+    */
+    inline void philox4x32(uint32_t c[4],uint32_t k0,uint32_t k1)
+    {
+        for(size_t r=0;r<10;++r)
+        {
+            const uint64_t product0 = static_cast<uint64_t>(c[0])*0xD2511F53u;
+            const uint64_t product1 = static_cast<uint64_t>(c[2])*0xCD9E8D57u;
+
+            const uint32_t c1 = c[1];
+
+            c[0] = static_cast<uint32_t>(product1 >> 32) ^ c1 ^ k0;
+            c[1] = static_cast<uint32_t>(product1);
+            c[2] = static_cast<uint32_t>(product0 >> 32) ^ c[3] ^ k1;
+            c[3] = static_cast<uint32_t>(product0);
+
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+    }
+
+    /*!
+        Counter based generator, numbers depend only on key (seed, layer, block, step)
+        and on their position in the stream, not on which thread draws them or when.
+        Every lane encrypts its own counter {draws, lane, step}, one pass over
+        lanes fills four blocks, the loop is vectorized by compiler.
+    */
+    class CounterRandom
+    {
+        typedef random_lanes_t lanes_t;
+
+        uint32_t outputs[4][MAX_SIMD_VECTOR_SIZE];
+
+        size_t output_id;
+
+        uint32_t key[2];
+
+        // number of passes so far
+        uint32_t draws;
+
+        uint32_t first_lane;
+
+        uint32_t step[2];
+
+        public:
+
+        CounterRandom(uint64_t seed,uint64_t layer,uint64_t block,uint64_t step)
+        {
+            uint64_t state = seed ^ splitmix64(layer);
+
+            const uint64_t mixed = splitmix64(state);
+
+            this->key[0] = static_cast<uint32_t>(mixed);
+            this->key[1] = static_cast<uint32_t>(mixed >> 32);
+
+            this->step[0] = static_cast<uint32_t>(step);
+            this->step[1] = static_cast<uint32_t>(step >> 32);
+
+            // every block owns MAX_SIMD_VECTOR_SIZE consecutive lane counters
+            this->first_lane = static_cast<uint32_t>(block*MAX_SIMD_VECTOR_SIZE);
+
+            this->draws = 0;
+
+            this->output_id = 4;
+        }
+
+        lanes_t next()
+        {
+            if( this->output_id == 4 )
+            {
+                for(uint32_t i=0;i<MAX_SIMD_VECTOR_SIZE;++i)
+                {
+                    uint32_t c[4] = {this->draws,this->first_lane + i,this->step[0],this->step[1]};
+
+                    philox4x32(c,this->key[0],this->key[1]);
+
+                    this->outputs[0][i] = c[0];
+                    this->outputs[1][i] = c[1];
+                    this->outputs[2][i] = c[2];
+                    this->outputs[3][i] = c[3];
+                }
+
+                this->draws++;
+
+                this->output_id = 0;
+            }
+
+            return lanes_t(this->outputs[this->output_id++],std::experimental::element_aligned);
+        }
+
+        SIMD uniform()
+        {
+            return random_lanes_uniform(this->next());
+        }
+
+        SIMD normal()
+        {
+            return random_lanes_normal(this->uniform());
+        }
+
+    };
+
+    /*!
+        Random numbers from Generator, SIMDRandom or CounterRandom. Scalars are
+        served from buffered SIMD batches, vectors are filled a block at a time.
+    */
+    template<class Generator>
+    class BasicRandomStream
+    {
+        Generator generator;
+
+        number uniforms[MAX_SIMD_VECTOR_SIZE];
+
+        number normals[MAX_SIMD_VECTOR_SIZE];
+
+        size_t uniform_id;
+
+        size_t normal_id;
+
+        // block of SIMDVectorLite remainder or full block
+        template<class V>
+        V resize(const SIMD& block)
+        {
+            if constexpr( V::size() == MAX_SIMD_VECTOR_SIZE )
+            {
+                return block;
+            }
+            else
+            {
+                return V([&block](auto i){ return block[i]; });
+            }
+        }
+
+        public:
+
+        template<class ... Args>
+        BasicRandomStream(Args ... args)
+        : generator(args...)
+        {
+            this->uniform_id = MAX_SIMD_VECTOR_SIZE;
+            this->normal_id = MAX_SIMD_VECTOR_SIZE;
+        }
+
+        void seed(uint64_t seed,uint64_t stream)
+        {
+            this->generator.seed(seed,stream);
+
+            this->uniform_id = MAX_SIMD_VECTOR_SIZE;
+            this->normal_id = MAX_SIMD_VECTOR_SIZE;
+        }
+
+        // uniform number in (0,1)
+        number uniform()
+        {
+            if( this->uniform_id == MAX_SIMD_VECTOR_SIZE )
+            {
+                this->generator.uniform().copy_to(this->uniforms,std::experimental::element_aligned);
+
+                this->uniform_id = 0;
+            }
+
+            return this->uniforms[this->uniform_id++];
+        }
+
+        number uniform(number a,number b)
+        {
+            return a + ( b - a )*this->uniform();
+        }
+
+        // standard normal number
+        number normal()
+        {
+            if( this->normal_id == MAX_SIMD_VECTOR_SIZE )
+            {
+                this->generator.normal().copy_to(this->normals,std::experimental::element_aligned);
+
+                this->normal_id = 0;
+            }
+
+            return this->normals[this->normal_id++];
+        }
+
+        number normal(number mean,number std)
+        {
+            return mean + std*this->normal();
+        }
+
+        /*!
+            Fill SIMDVectorLite or SIMDVector with uniform numbers in (a,b).
+        */
+        template<class Vector>
+        void uniform(Vector& vec,number a = 0.f,number b = 1.f)
+        {
+            vec = vec.map([this,a,b](const auto& block){ return a + ( b - a )*this->resize<std::remove_cvref_t<decltype(block)>>(this->generator.uniform()); });
+        }
+
+        /*!
+            Fill SIMDVectorLite or SIMDVector with normal numbers.
+        */
+        template<class Vector>
+        void normal(Vector& vec,number mean = 0.f,number std = 1.f)
+        {
+            vec = vec.map([this,mean,std](const auto& block){ return mean + std*this->resize<std::remove_cvref_t<decltype(block)>>(this->generator.normal()); });
+        }
+
+    };
+
+    // stream of a single thread
+    typedef BasicRandomStream<SIMDRandom> RandomStream;
+
+    // stream of a RandomScope
+    typedef BasicRandomStream<CounterRandom> CounterStream;
+
+    /*!
+        Seed shared by streams of all threads, epoch tells threads to reseed their
+        streams after set_random_seed.
+    */
+    struct RandomSeed
+    {
+        std::atomic<uint64_t> seed;
+
+        std::atomic<uint64_t> streams;
+
+        // layers take their random ids from here
+        std::atomic<uint64_t> layers;
+
+        std::atomic<uint32_t> epoch;
+
+        RandomSeed()
+        {
+            std::random_device rd;
+
+            this->seed = ( static_cast<uint64_t>(rd()) << 32 ) | rd();
+
+            this->streams = 0;
+
+            this->layers = 0;
+
+            this->epoch = 1;
+        }
+    };
+
+    inline RandomSeed& random_seed_state()
+    {
+        static RandomSeed state;
+
+        return state;
+    }
+
+    /*!
+        Make runs reproducible. Every thread reseeds its stream on next use, streams
+        get ids in order of that use, so single threaded runs and runs where threads
+        draw in fixed order repeat exactly. Without it seed comes from random_device.
+    */
+    inline void set_random_seed(uint64_t seed)
+    {
+        RandomSeed& state = random_seed_state();
+
+        state.seed = seed;
+
+        state.streams = 0;
+
+        state.layers = 0;
+
+        state.epoch++;
+    }
+
+    inline uint64_t random_seed()
+    {
+        return random_seed_state().seed.load(std::memory_order_relaxed);
+    }
+
+    /*!
+        Id of layer in keys of its RandomScope, layers get them in order of
+        construction, counting from zero after set_random_seed.
+    */
+    inline uint64_t next_random_layer()
+    {
+        return random_seed_state().layers.fetch_add(1,std::memory_order_relaxed);
+    }
+
+    /*!
+        Stream of current thread.
+    */
+    inline RandomStream& thread_random()
+    {
+        static thread_local RandomStream stream;
+
+        static thread_local uint32_t epoch = 0;
+
+        RandomSeed& state = random_seed_state();
+
+        const uint32_t current = state.epoch.load(std::memory_order_acquire);
+
+        if( epoch != current )
+        {
+            epoch = current;
+
+            stream.seed(state.seed.load(std::memory_order_relaxed),state.streams.fetch_add(1,std::memory_order_relaxed));
+        }
+
+        return stream;
+    }
+
+    inline CounterStream*& scoped_random()
+    {
+        static thread_local CounterStream* stream = nullptr;
+
+        return stream;
+    }
+
+    /*!
+        While it lives, random_uniform and random_normal of its thread draw from
+        counter stream keyed by (seed, layer, block, step). Work of a block done
+        inside of a scope gives the same numbers for any thread count or order
+        in which threads pick blocks. Scopes nest, the inner one wins.
+    */
+    class RandomScope
+    {
+        CounterStream stream;
+
+        CounterStream* previous;
+
+        public:
+
+        RandomScope(uint64_t seed,uint64_t layer,uint64_t block,uint64_t step)
+        : stream(seed,layer,block,step)
+        {
+            this->previous = scoped_random();
+
+            scoped_random() = &this->stream;
+        }
+
+        // key with global seed
+        RandomScope(uint64_t layer,uint64_t block,uint64_t step)
+        : RandomScope(random_seed(),layer,block,step)
+        {
+        }
+
+        RandomScope(const RandomScope&) = delete;
+
+        RandomScope& operator=(const RandomScope&) = delete;
+
+        ~RandomScope()
+        {
+            scoped_random() = this->previous;
+        }
+    };
+
+    /*
+        Draws from stream of innermost RandomScope of current thread, or from
+        thread_random when there is none.
+    */
+
+    inline number random_uniform()
+    {
+        CounterStream* stream = scoped_random();
+
+        return stream ? stream->uniform() : thread_random().uniform();
+    }
+
+    inline number random_uniform(number a,number b)
+    {
+        return a + ( b - a )*random_uniform();
+    }
+
+    inline number random_normal()
+    {
+        CounterStream* stream = scoped_random();
+
+        return stream ? stream->normal() : thread_random().normal();
+    }
+
+    inline number random_normal(number mean,number std)
+    {
+        return mean + std*random_normal();
+    }
+
+    template<class Vector>
+    void random_uniform(Vector& vec,number a = 0.f,number b = 1.f)
+    {
+        CounterStream* stream = scoped_random();
+
+        if( stream )
+        {
+            stream->uniform(vec,a,b);
+        }
+        else
+        {
+            thread_random().uniform(vec,a,b);
+        }
+    }
+
+    template<class Vector>
+    void random_normal(Vector& vec,number mean = 0.f,number std = 1.f)
+    {
+        CounterStream* stream = scoped_random();
+
+        if( stream )
+        {
+            stream->normal(vec,mean,std);
+        }
+        else
+        {
+            thread_random().normal(vec,mean,std);
+        }
+    }
+
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "config.hpp"
+
+/*
+    Hot kernels are compiled for several instruction sets in one binary, each
+    version is marked with target attribute and the best one supported by CPU is
+    chosen at runtime, so whole build can target a portable baseline.
+*/
+#if ( defined(__x86_64__) || defined(__i386__) ) && ( defined(__GNUC__) || defined(__clang__) )
+
+#define SNN_SIMD_DISPATCH
+
+#include <immintrin.h>
+
+#define SNN_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,f16c")))
+
+#define SNN_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+
+#endif
+
+namespace snn
+{
+    /*!
+        Instruction sets kernels are compiled for, in ascending order.
+    */
+    enum class SIMDLevel : uint8_t
+    {
+        Generic,
+        SSE4,
+        AVX2,
+        AVX512
+    };
+
+    /*!
+        Best level supported by CPU and operating system, read from CPUID.
+    */
+    inline SIMDLevel detect_simd_level()
+    {
+#if defined(SNN_SIMD_DISPATCH)
+
+        __builtin_cpu_init();
+
+        if( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl") )
+        {
+            return SIMDLevel::AVX512;
+        }
+
+        if( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c") )
+        {
+            return SIMDLevel::AVX2;
+        }
+
+        if( __builtin_cpu_supports("sse4.2") )
+        {
+            return SIMDLevel::SSE4;
+        }
+
+#endif
+
+        return SIMDLevel::Generic;
+    }
+
+    inline SIMDLevel& active_simd_level()
+    {
+        static SIMDLevel level = detect_simd_level();
+
+        return level;
+    }
+
+    /*!
+        Level used by kernels, detected once on first use.
+    */
+    inline SIMDLevel simd_level()
+    {
+        return active_simd_level();
+    }
+
+    /*!
+        Force kernels to lower level, for benchmarks and tests. Level above the
+        detected one is clamped. It is not synchronized, so call it before kernels
+        run in other threads.
+    */
+    inline void set_simd_level(SIMDLevel level)
+    {
+        active_simd_level() = std::min(level,detect_simd_level());
+    }
+
+    inline const char* simd_level_name(SIMDLevel level)
+    {
+        switch( level )
+        {
+            case SIMDLevel::AVX512:
+                return "AVX-512";
+
+            case SIMDLevel::AVX2:
+                return "AVX2";
+
+            case SIMDLevel::SSE4:
+                return "SSE4";
+
+            default:
+                return "generic";
+        }
+    }
+
+#if defined(SNN_SIMD_DISPATCH)
+
+    // maskz extract, _mm512_reduce_add_ps extracts with undefined source and gcc
+    // reports it as uninitialized at -O2
+    SNN_TARGET_AVX512 inline number simd_horizontal_avx512(__m512 acc)
+    {
+        const __m256 half = _mm256_add_ps(_mm512_maskz_extractf32x8_ps(0xFF,acc,0),_mm512_maskz_extractf32x8_ps(0xFF,acc,1));
+
+        const __m128 quarter = _mm_add_ps(_mm256_castps256_ps128(half),_mm256_extractf128_ps(half,1));
+
+        const __m128 pair = _mm_add_ps(quarter,_mm_movehl_ps(quarter,quarter));
+
+        return _mm_cvtss_f32(_mm_add_ss(pair,_mm_movehdup_ps(pair)));
+    }
+
+    SNN_TARGET_AVX512 inline number simd_sum_avx512(const number* a,size_t count)
+    {
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+
+        size_t i = 0;
+
+        for(;i+32<=count;i+=32)
+        {
+            acc0 = _mm512_add_ps(acc0,_mm512_loadu_ps(a+i));
+            acc1 = _mm512_add_ps(acc1,_mm512_loadu_ps(a+i+16));
+        }
+
+        for(;i<count;i+=16)
+        {
+            const __mmask16 mask = count - i >= 16 ? 0xFFFF : ( 1u << ( count - i ) ) - 1;
+
+            acc0 = _mm512_add_ps(acc0,_mm512_maskz_loadu_ps(mask,a+i));
+        }
+
+        return simd_horizontal_avx512(_mm512_add_ps(acc0,acc1));
+    }
+
+    SNN_TARGET_AVX512 inline number simd_dot_avx512(const number* a,const number* b,size_t count)
+    {
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+
+        size_t i = 0;
+
+        for(;i+32<=count;i+=32)
+        {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i),_mm512_loadu_ps(b+i),acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+16),_mm512_loadu_ps(b+i+16),acc1);
+        }
+
+        for(;i<count;i+=16)
+        {
+            const __mmask16 mask = count - i >= 16 ? 0xFFFF : ( 1u << ( count - i ) ) - 1;
+
+            acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask,a+i),_mm512_maskz_loadu_ps(mask,b+i),acc0);
+        }
+
+        return simd_horizontal_avx512(_mm512_add_ps(acc0,acc1));
+    }
+
+    SNN_TARGET_AVX2 inline number simd_horizontal_avx2(__m256 acc)
+    {
+        const __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),_mm256_extractf128_ps(acc,1));
+
+        const __m128 pair = _mm_add_ps(half,_mm_movehl_ps(half,half));
+
+        return _mm_cvtss_f32(_mm_add_ss(pair,_mm_movehdup_ps(pair)));
+    }
+
+    SNN_TARGET_AVX2 inline number simd_sum_avx2(const number* a,size_t count)
+    {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+
+        size_t i = 0;
+
+        for(;i+16<=count;i+=16)
+        {
+            acc0 = _mm256_add_ps(acc0,_mm256_loadu_ps(a+i));
+            acc1 = _mm256_add_ps(acc1,_mm256_loadu_ps(a+i+8));
+        }
+
+        number sum = simd_horizontal_avx2(_mm256_add_ps(acc0,acc1));
+
+        for(;i<count;++i)
+        {
+            sum += a[i];
+        }
+
+        return sum;
+    }
+
+    SNN_TARGET_AVX2 inline number simd_dot_avx2(const number* a,const number* b,size_t count)
+    {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+
+        size_t i = 0;
+
+        for(;i+16<=count;i+=16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i),acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8),_mm256_loadu_ps(b+i+8),acc1);
+        }
+
+        number sum = simd_horizontal_avx2(_mm256_add_ps(acc0,acc1));
+
+        for(;i<count;++i)
+        {
+            sum += a[i]*b[i];
+        }
+
+        return sum;
+    }
+
+#endif
+
+    /*!
+        Sum of count numbers, with the best instruction set available.
+    */
+    inline number simd_sum(const number* a,size_t count)
+    {
+#if defined(SNN_SIMD_DISPATCH)
+
+        switch( simd_level() )
+        {
+            case SIMDLevel::AVX512:
+                return simd_sum_avx512(a,count);
+
+            case SIMDLevel::AVX2:
+                return simd_sum_avx2(a,count);
+
+            default:
+                break;
+        }
+
+#endif
+
+        number sum = 0.f;
+
+        for(size_t i=0;i<count;++i)
+        {
+            sum += a[i];
+        }
+
+        return sum;
+    }
+
+    /*!
+        Dot product of two arrays of count numbers, with the best instruction set available.
+    */
+    inline number simd_dot(const number* a,const number* b,size_t count)
+    {
+#if defined(SNN_SIMD_DISPATCH)
+
+        switch( simd_level() )
+        {
+            case SIMDLevel::AVX512:
+                return simd_dot_avx512(a,b,count);
+
+            case SIMDLevel::AVX2:
+                return simd_dot_avx2(a,b,count);
+
+            default:
+                break;
+        }
+
+#endif
+
+        number sum = 0.f;
+
+        for(size_t i=0;i<count;++i)
+        {
+            sum += a[i]*b[i];
+        }
+
+        return sum;
+    }
+
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <experimental/simd>
+
+#include "config.hpp"
+
+namespace snn
+{
+    /*!
+        Vectorized exp, log, tanh, sigmoid, SiLU and erfinv of float SIMD blocks, of any width,
+        so they work on SIMD and on remainders of SIMDVectorLite. Range is reduced to
+        a small interval and a polynomial is evaluated there, coefficients are the ones
+        of Cephes single precision library.
+
+        Maximal error against correctly rounded result, measured by test_simd_math in
+        tests.cpp:
+
+        simd_exp     - 2 ULP for x in [-87,88], saturates at FLT_MAX above 88.72
+                       and goes to zero below -104.
+        simd_log     - 2 ULP for positive normal x, -inf for 0 and NaN below 0.
+        simd_tanh    - 2 ULP.
+        simd_sigmoid - 4 ULP for x above -87, below it absolute error is under 1e-38.
+        simd_silu    - 4 ULP.
+
+        Denormal inputs are not supported, builds with -ffast-math flush them anyway.
+    */
+
+    template<class V>
+    using simd_int_t = std::experimental::rebind_simd_t<int32_t,V>;
+
+    // bits of float lanes as integers and back, through an aligned buffer that compiles to register move
+    template<class V>
+    inline simd_int_t<V> simd_to_bits(const V& x)
+    {
+        alignas(std::experimental::memory_alignment_v<V>) float lanes[V::size()];
+
+        alignas(std::experimental::memory_alignment_v<simd_int_t<V>>) int32_t bits[V::size()];
+
+        x.copy_to(lanes,std::experimental::vector_aligned);
+
+        memcpy(bits,lanes,sizeof(lanes));
+
+        return simd_int_t<V>(bits,std::experimental::vector_aligned);
+    }
+
+    template<class V>
+    inline V simd_from_bits(const simd_int_t<V>& x)
+    {
+        alignas(std::experimental::memory_alignment_v<simd_int_t<V>>) int32_t bits[V::size()];
+
+        alignas(std::experimental::memory_alignment_v<V>) float lanes[V::size()];
+
+        x.copy_to(bits,std::experimental::vector_aligned);
+
+        memcpy(lanes,bits,sizeof(bits));
+
+        return V(lanes,std::experimental::vector_aligned);
+    }
+
+    // 2^n for integer n in [-126,127]
+    template<class V>
+    inline V simd_pow2(const simd_int_t<V>& n)
+    {
+        return simd_from_bits<V>(( n + 127 ) << 23);
+    }
+
+    /*!
+        Hide value from optimizer, so -ffast-math can't reassociate expressions
+        that split constants on purpose. It costs one store and load.
+    */
+    template<class V>
+    inline V simd_opaque(V x)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+
+        asm("" : "+m"(x));
+
+#endif
+
+        return x;
+    }
+
+    /*!
+        sqrt(x) for x >= 0 as x times reciprocal square root, first guess from exponent
+        bits is refined by Newton steps. Used instead of std::experimental::sqrt, whose
+        AVX-512 version passes undefined source that gcc reports at -O2.
+    */
+    template<class V>
+    inline V simd_sqrt(const V& x)
+    {
+        V y = simd_from_bits<V>(0x5F375A86 - ( simd_to_bits(x) >> 1 ));
+
+        const V half = 0.5f*x;
+
+        for(int step=0;step<3;++step)
+        {
+            y = y*( 1.5f - half*y*y );
+        }
+
+        return x*y;
+    }
+
+    /*!
+        exp(x) = 2^n * exp(r), where n = round(x/ln2) and |r| <= ln2/2.
+    */
+    template<class V>
+    inline V simd_exp(const V& x)
+    {
+        const V clamped = std::experimental::min(std::experimental::max(x,V(-104.f)),V(88.72283f));
+
+        // round to nearest by adding 1.5*2^23, kept opaque so fast math doesn't drop it,
+        // floor of AVX-512 blocks passes undefined source that gcc reports at -O2
+        const V n = simd_opaque(clamped*1.44269504088896341f + 12582912.f) - 12582912.f;
+
+        // ln2 is split in two parts, so r keeps its precision, the first product is
+        // exact and its difference is kept opaque, so fast math can't reorder them
+        const V r = simd_opaque(clamped - n*0.693359375f) + n*2.12194440e-4f;
+
+        V p = 1.9875691500e-4f;
+
+        p = p*r + 1.3981999507e-3f;
+        p = p*r + 8.3334519073e-3f;
+        p = p*r + 4.1665795894e-2f;
+        p = p*r + 1.6666665459e-1f;
+        p = p*r + 5.0000001201e-1f;
+
+        p = p*r*r + r + 1.f;
+
+        // 2^n is applied in two halves, so ends of range don't overflow exponent, the
+        // first one is added to exponent bits of p
+        const simd_int_t<V> exponent = std::experimental::static_simd_cast<simd_int_t<V>>(n);
+
+        const simd_int_t<V> half = exponent >> 1;
+
+        return simd_from_bits<V>(simd_to_bits(p) + ( half << 23 ))*simd_pow2<V>(exponent - half);
+    }
+
+    /*!
+        log(x) = e*ln2 + log(m), where x = m*2^e and m is in [sqrt(1/2),sqrt(2)).
+    */
+    template<class V>
+    inline V simd_log(const V& x)
+    {
+        const simd_int_t<V> bits = simd_to_bits(x);
+
+        V e = std::experimental::static_simd_cast<V>(( bits >> 23 ) - 127);
+
+        V m = simd_from_bits<V>(( bits & 0x007FFFFF ) | 0x3F800000);
+
+        const auto big = m > 1.41421356237309505f;
+
+        where(big,m) *= 0.5f;
+        where(big,e) += 1.f;
+
+        const V f = m - 1.f;
+
+        const V z = f*f;
+
+        V p = 7.0376836292e-2f;
+
+        p = p*f - 1.1514610310e-1f;
+        p = p*f + 1.1676998740e-1f;
+        p = p*f - 1.2420140846e-1f;
+        p = p*f + 1.4249322787e-1f;
+        p = p*f - 1.6668057665e-1f;
+        p = p*f + 2.0000714765e-1f;
+        p = p*f - 2.4999993993e-1f;
+        p = p*f + 3.3333331174e-1f;
+
+        V y = p*f*z;
+
+        y = y - e*2.12194440e-4f;
+
+        y = y - 0.5f*z;
+
+        V output = f + y + e*0.693359375f;
+
+        where(x == 0.f,output) = -std::numeric_limits<float>::infinity();
+        where(x < 0.f,output) = std::numeric_limits<float>::quiet_NaN();
+
+        return output;
+    }
+
+    /*!
+        Odd polynomial near zero, where 1 - 2/(exp(2x)+1) would lose precision to
+        cancellation, exp based formula elsewhere.
+    */
+    template<class V>
+    inline V simd_tanh(const V& x)
+    {
+        const V ax = std::experimental::abs(x);
+
+        const V z = x*x;
+
+        V p = -5.70498872745e-3f;
+
+        p = p*z + 2.06390887954e-2f;
+        p = p*z - 5.37397155531e-2f;
+        p = p*z + 1.33314422036e-1f;
+        p = p*z - 3.33332819422e-1f;
+
+        V output = p*z*x + x;
+
+        V far = 1.f - 2.f/(simd_exp(ax + ax) + 1.f);
+
+        where(x < 0.f,far) = -far;
+
+        where(ax >= 0.625f,output) = far;
+
+        return output;
+    }
+
+    template<class V>
+    inline V simd_sigmoid(const V& x)
+    {
+        return 1.f/(1.f + simd_exp(-x));
+    }
+
+    template<class V>
+    inline V simd_silu(const V& x)
+    {
+        return x/(1.f + simd_exp(-x));
+    }
+
+    /*!
+        Inverse of erf for x in (-1,1), single precision approximation of M. Giles,
+        both branches are evaluated and selected per lane. Relative error is
+        below 4e-7, random normals are made from it by sqrt(2)*erfinv(2u - 1).
+    */
+    template<class V>
+    inline V simd_erfinv(const V& x)
+    {
+        V w = -simd_log(( 1.f - x )*( 1.f + x ));
+
+        const V central = w - 2.5f;
+
+        V p = 2.81022636e-08f;
+
+        p = p*central + 3.43273939e-07f;
+        p = p*central - 3.5233877e-06f;
+        p = p*central - 4.39150654e-06f;
+        p = p*central + 2.1858087e-04f;
+        p = p*central - 1.25372503e-03f;
+        p = p*central - 4.17768164e-03f;
+        p = p*central + 2.46640727e-01f;
+        p = p*central + 1.50140941f;
+
+        const V tail = simd_sqrt(w) - 3.f;
+
+        V q = -2.00214257e-04f;
+
+        q = q*tail + 1.00950558e-04f;
+        q = q*tail + 1.34934322e-03f;
+        q = q*tail - 3.67342844e-03f;
+        q = q*tail + 5.73950773e-03f;
+        q = q*tail - 7.6224613e-03f;
+        q = q*tail + 9.43887047e-03f;
+        q = q*tail + 1.00167406f;
+        q = q*tail + 2.83297682f;
+
+        where(w >= 5.f,p) = q;
+
+        return p*x;
+    }
+
+}
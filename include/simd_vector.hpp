@@ -174,8 +174,39 @@ namespace snn
             return this->vec.size();
         }
 
+        /*!
+            New vector with function applied to every block, padding of the last
+            block is kept zero, so reduce stays correct.
+        */
+        template<class Function>
+        SIMDVector map(Function function) const
+        {
+            SIMDVector output;
+
+            output.vec.reserve(this->vec.size());
+
+            for(const SIMD& block : this->vec)
+            {
+                output.vec.push_back(function(block));
+            }
+
+            if( !output.vec.empty() )
+            {
+                where(this->get_partially_filled_simd(this->ptr,0.f,1.f) > 0.f,output.vec.back()) = 0.f;
+            }
+
+            output.ptr = this->ptr;
+
+            return output;
+        }
+
         number reduce() const;
 
+        /*!
+            Biggest element, padding of the last block is skipped.
+        */
+        number max() const;
+
         number length() const;
 
         number operator[](const size_t& i) const;
@@ -2,10 +2,17 @@
 
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <variant>
 #include <functional>
+#include <type_traits>
+#include <algorithm>
+#include <new>
+#include <utility>
 
 #include "config.hpp"
+#include "simd_dispatch.hpp"
+#include "simd_math.hpp"
 
 namespace snn
 {
@@ -14,16 +21,217 @@ namespace snn
 
 #define VEC_REMAINDER (static_cast<size_t>(Size - VEC_COUNT*MAX_SIMD_VECTOR_SIZE))
 
+template<size_t Size>
+class SIMDVectorLite;
+
+template<class Op,class Left,class Right>
+class SIMDExpression;
+
+template<size_t Size>
+class SIMDScalar;
+
+/*!
+    Types that take part in lazy SIMDVectorLite arithmetic, vectors and expressions.
+*/
+template<class T>
+struct is_simd_operand : std::false_type
+{};
+
+template<size_t Size>
+struct is_simd_operand<SIMDVectorLite<Size>> : std::true_type
+{};
+
+template<class Op,class Left,class Right>
+struct is_simd_operand<SIMDExpression<Op,Left,Right>> : std::true_type
+{};
+
+template<class T>
+struct is_simd_expression : std::false_type
+{};
+
+template<class Op,class Left,class Right>
+struct is_simd_expression<SIMDExpression<Op,Left,Right>> : std::true_type
+{};
+
+template<class T>
+concept SIMDOperand = is_simd_operand<std::remove_cvref_t<T>>::value;
+
+template<class T>
+concept SIMDLazy = is_simd_expression<std::remove_cvref_t<T>>::value;
+
+template<class T>
+constexpr size_t simd_elements = std::remove_cvref_t<T>::elements;
+
+/*!
+    How expression keeps its operand. Named vectors are referenced, temporary vectors
+    are moved into expression, so auto d = a.fire(x) - b.fire(x) stays valid.
+    Expressions and scalars are small and kept by value.
+*/
+template<class T>
+using simd_operand_t = std::conditional_t< std::is_lvalue_reference_v<T> && !is_simd_expression<std::remove_cvref_t<T>>::value, const std::remove_cvref_t<T>&, std::remove_cvref_t<T> >;
+
+/*!
+    Blocks kept inside of SIMDVectorLite, used for small vectors.
+*/
+template<size_t Count>
+struct SIMDInlineBlocks
+{
+    SIMD blocks[Count];
+
+    SIMD& operator[](size_t i)
+    {
+        return this->blocks[i];
+    }
+
+    const SIMD& operator[](size_t i) const
+    {
+        return this->blocks[i];
+    }
+
+    SIMD* begin()
+    {
+        return this->blocks;
+    }
+
+    SIMD* end()
+    {
+        return this->blocks + Count;
+    }
+
+    const SIMD* begin() const
+    {
+        return this->blocks;
+    }
+
+    const SIMD* end() const
+    {
+        return this->blocks + Count;
+    }
+};
+
+/*!
+    Blocks kept in aligned heap buffer, used for vectors above SIMD_VECTOR_HEAP_THRESHOLD.
+    Copy duplicates the buffer and move steals it, moved from vector can only be
+    assigned to or destroyed.
+*/
+template<size_t Count>
+class SIMDHeapBlocks
+{
+    static constexpr std::align_val_t alignment = std::align_val_t(std::max<size_t>(SIMD_VECTOR_HEAP_ALIGNMENT,alignof(SIMD)));
+
+    SIMD* blocks;
+
+    static SIMD* allocate()
+    {
+        return new(::operator new[](Count*sizeof(SIMD),alignment)) SIMD[Count];
+    }
+
+    void release()
+    {
+        if( this->blocks )
+        {
+            ::operator delete[](this->blocks,alignment);
+        }
+    }
+
+    public:
+
+    SIMDHeapBlocks()
+    {
+        this->blocks = allocate();
+    }
+
+    SIMDHeapBlocks(const SIMDHeapBlocks& other)
+    {
+        this->blocks = allocate();
+
+        std::copy(other.blocks,other.blocks+Count,this->blocks);
+    }
+
+    SIMDHeapBlocks(SIMDHeapBlocks&& other) noexcept
+    {
+        this->blocks = other.blocks;
+
+        other.blocks = nullptr;
+    }
+
+    SIMDHeapBlocks& operator=(const SIMDHeapBlocks& other)
+    {
+        if( this != &other )
+        {
+            if( !this->blocks )
+            {
+                this->blocks = allocate();
+            }
+
+            std::copy(other.blocks,other.blocks+Count,this->blocks);
+        }
+
+        return *this;
+    }
+
+    SIMDHeapBlocks& operator=(SIMDHeapBlocks&& other) noexcept
+    {
+        std::swap(this->blocks,other.blocks);
+
+        return *this;
+    }
+
+    ~SIMDHeapBlocks()
+    {
+        this->release();
+    }
+
+    SIMD& operator[](size_t i)
+    {
+        return this->blocks[i];
+    }
+
+    const SIMD& operator[](size_t i) const
+    {
+        return this->blocks[i];
+    }
+
+    SIMD* begin()
+    {
+        return this->blocks;
+    }
+
+    SIMD* end()
+    {
+        return this->blocks + Count;
+    }
+
+    const SIMD* begin() const
+    {
+        return this->blocks;
+    }
+
+    const SIMD* end() const
+    {
+        return this->blocks + Count;
+    }
+};
+
+/*!
+    Storage policy of SIMDVectorLite blocks, chosen by vector size.
+*/
+template<size_t Size>
+using SIMDBlocks = std::conditional_t< ( Size > SIMD_VECTOR_HEAP_THRESHOLD ), SIMDHeapBlocks<VEC_COUNT>, SIMDInlineBlocks<VEC_COUNT> >;
+
 template<size_t Size>
 class SIMDVectorLite
 {
+    template<class,class,class>
+    friend class SIMDExpression;
+
 private:
 
     struct Empty
     {};
 
     /* data */
-    SIMD _vec[VEC_COUNT];
+    SIMDBlocks<Size> _vec;
 
     using remainder_simd = std::experimental::fixed_size_simd<number , VEC_REMAINDER >;
 
@@ -169,6 +377,14 @@ private:
         return output;
     }
 
+    // full blocks are one contiguous array of numbers, for dispatched kernels
+    const number* block_data() const
+    {
+        static_assert(sizeof(SIMD) == MAX_SIMD_VECTOR_SIZE*sizeof(number),"SIMD blocks have to be packed");
+
+        return reinterpret_cast<const number*>(&this->_vec[0]);
+    }
+
     remainder_type mask_to_remainder(const remainder_type_mask& mask) const
     {
 
@@ -186,18 +402,32 @@ private:
 
 
 public:
+
+    static constexpr size_t elements = Size;
+
     SIMDVectorLite();
 
     SIMDVectorLite(number nm);
 
+    template<SIMDLazy Expression>
+    SIMDVectorLite(const Expression& expression);
+
+    template<SIMDLazy Expression>
+    SIMDVectorLite& operator=(const Expression& expression);
+
     SIMDVectorLite(const std::array<number,Size>& arr);
 
-    // SIMDVectorLite(const SIMDVectorLite& vec);
+    SIMDVectorLite(const SIMDVectorLite& vec) = default;
 
-    // SIMDVectorLite(SIMDVectorLite&& vec);
+    // big vectors give away their heap blocks
+    SIMDVectorLite(SIMDVectorLite&& vec) = default;
 
     number reduce() const;
 
+    number max() const;
+
+    number dot(const SIMDVectorLite<Size>& v) const;
+
     number operator[](size_t i) const;
 
     SIMD_reference operator[](size_t i);
@@ -244,6 +474,38 @@ public:
         this->_vec[i] = block;
     }
 
+    /*!
+        Store all elements into plain array of at least Size numbers.
+    */
+    void copy_to(number* out) const
+    {
+        for(size_t i=0;i<VEC_COUNT;++i)
+        {
+            this->_vec[i].copy_to(out + i*MAX_SIMD_VECTOR_SIZE,std::experimental::element_aligned);
+        }
+
+        if constexpr(VEC_REMAINDER != 0)
+        {
+            this->remainder.copy_to(out + VEC_COUNT*MAX_SIMD_VECTOR_SIZE,std::experimental::element_aligned);
+        }
+    }
+
+    /*!
+        Load all elements from plain array of at least Size numbers.
+    */
+    void copy_from(const number* in)
+    {
+        for(size_t i=0;i<VEC_COUNT;++i)
+        {
+            this->_vec[i].copy_from(in + i*MAX_SIMD_VECTOR_SIZE,std::experimental::element_aligned);
+        }
+
+        if constexpr(VEC_REMAINDER != 0)
+        {
+            this->remainder.copy_from(in + VEC_COUNT*MAX_SIMD_VECTOR_SIZE,std::experimental::element_aligned);
+        }
+    }
+
     simd_variant get_block(size_t i)
     {        
         if( i == VEC_COUNT )
@@ -259,9 +521,9 @@ public:
         return std::ref(this->_vec[i]);
     }
 
-    // void operator=(const SIMDVectorLite& vec);
+    SIMDVectorLite& operator=(const SIMDVectorLite& vec) = default;
 
-    // void operator=(SIMDVectorLite&& vec);
+    SIMDVectorLite& operator=(SIMDVectorLite&& vec) = default;
 
     void operator+=(number v);
 
@@ -271,15 +533,6 @@ public:
 
     void operator/=(number v);
 
-    SIMDVectorLite operator+(number v) const;
-
-    SIMDVectorLite operator-(number v) const;
-
-    SIMDVectorLite operator*(number v) const;
-
-    SIMDVectorLite operator/(number v) const;
-
-
     void operator+=(const SIMDVectorLite<Size>& v);
 
     void operator-=(const SIMDVectorLite<Size>& v);
@@ -288,13 +541,17 @@ public:
 
     void operator/=(const SIMDVectorLite<Size>& v);
 
-    SIMDVectorLite operator+(const SIMDVectorLite<Size>& v) const;
+    template<SIMDLazy Expression>
+    void operator+=(const Expression& expression);
 
-    SIMDVectorLite operator-(const SIMDVectorLite<Size>& v) const;
+    template<SIMDLazy Expression>
+    void operator-=(const Expression& expression);
 
-    SIMDVectorLite operator*(const SIMDVectorLite<Size>& v) const;
+    template<SIMDLazy Expression>
+    void operator*=(const Expression& expression);
 
-    SIMDVectorLite operator/(const SIMDVectorLite<Size>& v) const;
+    template<SIMDLazy Expression>
+    void operator/=(const Expression& expression);
 
 
 
@@ -310,6 +567,57 @@ public:
 
     SIMDVectorLite operator<(const SIMDVectorLite<Size>& v) const;
 
+    /*!
+        New vector with function applied to every block and to remainder, function
+        has to accept SIMD types of any width, like kernels from simd_math.hpp.
+    */
+    template<class Function>
+    SIMDVectorLite map(Function function) const
+    {
+        SIMDVectorLite output;
+
+        for(size_t i=0;i<VEC_COUNT;++i)
+        {
+            output._vec[i] = function(this->_vec[i]);
+        }
+
+        if constexpr(VEC_REMAINDER != 0)
+        {
+            output.remainder = function(this->remainder);
+        }
+
+        return output;
+    }
+
+    /*!
+        Sum of function applied to every block and to remainder, results are
+        accumulated in registers and never stored.
+    */
+    template<class Function>
+    number map_reduce(Function function) const
+    {
+        number output = 0.f;
+
+        if constexpr(VEC_COUNT != 0)
+        {
+            SIMD sum = function(this->_vec[0]);
+
+            for(size_t i=1;i<VEC_COUNT;++i)
+            {
+                sum += function(this->_vec[i]);
+            }
+
+            output = std::experimental::reduce(sum);
+        }
+
+        if constexpr(VEC_REMAINDER != 0)
+        {
+            output += std::experimental::reduce(function(this->remainder));
+        }
+
+        return output;
+    }
+
     snn::SIMDVectorLite<Size> exp();
 
     // template<size_t Size1>
@@ -451,9 +759,9 @@ number SIMDVectorLite<Size>:: reduce() const
 {
     number output = 0;
 
-    for(const SIMD& simd : this->_vec)
+    if constexpr( VEC_COUNT != 0 )
     {
-        output+=std::experimental::reduce(simd);
+        output = simd_sum(this->block_data(),VEC_COUNT*MAX_SIMD_VECTOR_SIZE);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
@@ -464,6 +772,56 @@ number SIMDVectorLite<Size>:: reduce() const
     return output;
 }
 
+/*!
+    Biggest element, blocks are compared lane wise and reduced once at the end.
+*/
+template<size_t Size>
+number SIMDVectorLite<Size>::max() const
+{
+    number output = std::numeric_limits<number>::lowest();
+
+    if constexpr( VEC_COUNT != 0 )
+    {
+        SIMD lanes = this->_vec[0];
+
+        for(size_t i=1;i<VEC_COUNT;++i)
+        {
+            lanes = std::experimental::max(lanes,this->_vec[i]);
+        }
+
+        output = std::experimental::hmax(lanes);
+    }
+
+    if constexpr( VEC_REMAINDER != 0 )
+    {
+        output = std::max(output,std::experimental::hmax(this->remainder));
+    }
+
+    return output;
+}
+
+/*!
+    Sum of products of elements, same as (*this * v).reduce() but full blocks go
+    through runtime dispatched kernel.
+*/
+template<size_t Size>
+number SIMDVectorLite<Size>::dot(const SIMDVectorLite<Size>& v) const
+{
+    number output = 0;
+
+    if constexpr( VEC_COUNT != 0 )
+    {
+        output = simd_dot(this->block_data(),v.block_data(),VEC_COUNT*MAX_SIMD_VECTOR_SIZE);
+    }
+
+    if constexpr( VEC_REMAINDER != 0 )
+    {
+        output += std::experimental::reduce(this->remainder*v.remainder);
+    }
+
+    return output;
+}
+
 template<size_t Size>
 number SIMDVectorLite<Size>::operator[](size_t i) const
 {
@@ -604,357 +962,455 @@ void SIMDVectorLite<Size>::operator/=(number v)
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator+(number v) const
+void SIMDVectorLite<Size>::operator+=(const SIMDVectorLite<Size>& v)
 {
-    SIMDVectorLite<Size> output;
-    
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] + v;
+        this->_vec[i] += v._vec[i];
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder + v;
+        this->remainder += v.remainder;
     }
-
-    return output;
-
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator-(number v) const
+void SIMDVectorLite<Size>::operator-=(const SIMDVectorLite<Size>& v)
 {
-    SIMDVectorLite<Size> output;
-    
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] - v;
+        this->_vec[i] -= v._vec[i];
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder - v;
+        this->remainder -= v.remainder;
     }
-
-    return output;
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator*(number v) const
+void SIMDVectorLite<Size>::operator*=(const SIMDVectorLite<Size>& v)
 {
-    SIMDVectorLite<Size> output;
-    
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] * v;
+        this->_vec[i] *= v._vec[i];
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder * v;
+        this->remainder *= v.remainder;
     }
-
-    return output;
-
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator/(number v) const
+void SIMDVectorLite<Size>::operator/=(const SIMDVectorLite<Size>& v)
 {
-
-    SIMDVectorLite<Size> output;
-    
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] / v;
+        this->_vec[i] /= v._vec[i];
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder / v;
+        this->remainder /= v.remainder;
     }
-
-    return output;
-
 }
 
 template<size_t Size>
-void SIMDVectorLite<Size>::operator+=(const SIMDVectorLite<Size>& v)
+SIMDVectorLite<Size> SIMDVectorLite<Size>::operator==(const SIMDVectorLite<Size>& v) const
 {
+    SIMDVectorLite<Size> output;
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        this->_vec[i] += v._vec[i];
+        output._vec[i] = this->mask_to_simd(this->_vec[i] == v._vec[i]);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        this->remainder += v.remainder;
+
+        output.remainder = this->mask_to_remainder(this->remainder == v.remainder);
+
     }
+
+    return output;
 }
 
 template<size_t Size>
-void SIMDVectorLite<Size>::operator-=(const SIMDVectorLite<Size>& v)
+SIMDVectorLite<Size> SIMDVectorLite<Size>::operator!=(const SIMDVectorLite<Size>& v) const
 {
+    SIMDVectorLite<Size> output;
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        this->_vec[i] -= v._vec[i];
+        output._vec[i] = this->mask_to_simd(this->_vec[i] != v._vec[i]);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        this->remainder -= v.remainder;
+
+        output.remainder = this->mask_to_remainder(this->remainder != v.remainder);
+
     }
+
+    return output;
+
 }
 
 template<size_t Size>
-void SIMDVectorLite<Size>::operator*=(const SIMDVectorLite<Size>& v)
+SIMDVectorLite<Size> SIMDVectorLite<Size>::operator>=(const SIMDVectorLite<Size>& v) const
 {
+    SIMDVectorLite<Size> output;
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        this->_vec[i] *= v._vec[i];
+        output._vec[i] = this->mask_to_simd(this->_vec[i] >= v._vec[i]);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        this->remainder *= v.remainder;
+
+        output.remainder = this->mask_to_remainder(this->remainder >= v.remainder);
+
     }
+
+    return output;
 }
 
 template<size_t Size>
-void SIMDVectorLite<Size>::operator/=(const SIMDVectorLite<Size>& v)
+SIMDVectorLite<Size> SIMDVectorLite<Size>::operator<=(const SIMDVectorLite<Size>& v) const
 {
+    SIMDVectorLite<Size> output;
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        this->_vec[i] /= v._vec[i];
+        output._vec[i] = this->mask_to_simd(this->_vec[i] <= v._vec[i]);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        this->remainder /= v.remainder;
+
+        output.remainder = this->mask_to_remainder(this->remainder <= v.remainder);
+
     }
+
+    return output;
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator+(const SIMDVectorLite<Size>& v) const
+SIMDVectorLite<Size> SIMDVectorLite<Size>::operator>(const SIMDVectorLite<Size>& v) const
 {
     SIMDVectorLite<Size> output;
-    
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] + v._vec[i];
+        output._vec[i] = this->mask_to_simd(this->_vec[i] > v._vec[i]);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder + v.remainder;
+
+        output.remainder = this->mask_to_remainder(this->remainder > v.remainder);
+
     }
 
     return output;
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator-(const SIMDVectorLite<Size>& v) const
+SIMDVectorLite<Size> SIMDVectorLite<Size>::operator<(const SIMDVectorLite<Size>& v) const
 {
     SIMDVectorLite<Size> output;
-    
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] - v._vec[i];
+        output._vec[i] = this->mask_to_simd(this->_vec[i] < v._vec[i]);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder - v.remainder;
+
+        output.remainder = this->mask_to_remainder(this->remainder < v.remainder);
+
     }
 
     return output;
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator*(const SIMDVectorLite<Size>& v) const
+SIMDVectorLite<Size>::~SIMDVectorLite()
 {
-    SIMDVectorLite<Size> output;
-    
+}
+
+template<size_t Size>
+snn::SIMDVectorLite<Size> snn::SIMDVectorLite<Size>::exp()
+{
+
+    return this->map([](const auto& block){ return snn::simd_exp(block); });
+}
+
+template<size_t Size>
+template<SIMDLazy Expression>
+SIMDVectorLite<Size>::SIMDVectorLite(const Expression& expression)
+{
+    *this = expression;
+}
+
+/*!
+    Evaluate expression in a single loop over SIMD blocks, without temporary vectors.
+    Each block is computed whole before it is stored, so vector can appear on both
+    sides, like in a = a*b + c.
+*/
+template<size_t Size>
+template<SIMDLazy Expression>
+SIMDVectorLite<Size>& SIMDVectorLite<Size>::operator=(const Expression& expression)
+{
+    static_assert(Expression::elements == Size,"SIMDVectorLite expression size mismatch");
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] * v._vec[i];
+        this->_vec[i] = expression.block(i);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder * v.remainder;
+        this->remainder = expression.tail();
     }
 
-    return output;
+    return *this;
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator/(const SIMDVectorLite<Size>& v) const
+template<SIMDLazy Expression>
+void SIMDVectorLite<Size>::operator+=(const Expression& expression)
 {
-    SIMDVectorLite<Size> output;
-    
+    static_assert(Expression::elements == Size,"SIMDVectorLite expression size mismatch");
+
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->_vec[i] / v._vec[i];
+        this->_vec[i] += expression.block(i);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-        output.remainder = this->remainder / v.remainder;
+        this->remainder += expression.tail();
     }
-
-    return output;
 }
 
-
-
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator==(const SIMDVectorLite<Size>& v) const
+template<SIMDLazy Expression>
+void SIMDVectorLite<Size>::operator-=(const Expression& expression)
 {
-    SIMDVectorLite<Size> output;
+    static_assert(Expression::elements == Size,"SIMDVectorLite expression size mismatch");
 
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->mask_to_simd(this->_vec[i] == v._vec[i]);
+        this->_vec[i] -= expression.block(i);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-
-        output.remainder = this->mask_to_remainder(this->remainder == v.remainder);
-
+        this->remainder -= expression.tail();
     }
-
-    return output;
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator!=(const SIMDVectorLite<Size>& v) const
+template<SIMDLazy Expression>
+void SIMDVectorLite<Size>::operator*=(const Expression& expression)
 {
-    SIMDVectorLite<Size> output;
+    static_assert(Expression::elements == Size,"SIMDVectorLite expression size mismatch");
 
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->mask_to_simd(this->_vec[i] != v._vec[i]);
+        this->_vec[i] *= expression.block(i);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-
-        output.remainder = this->mask_to_remainder(this->remainder != v.remainder);
-
+        this->remainder *= expression.tail();
     }
-
-    return output;
-
 }
 
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator>=(const SIMDVectorLite<Size>& v) const
+template<SIMDLazy Expression>
+void SIMDVectorLite<Size>::operator/=(const Expression& expression)
 {
-    SIMDVectorLite<Size> output;
+    static_assert(Expression::elements == Size,"SIMDVectorLite expression size mismatch");
 
     for(size_t i=0;i<VEC_COUNT;++i)
     {
-        output._vec[i] = this->mask_to_simd(this->_vec[i] >= v._vec[i]);
+        this->_vec[i] /= expression.block(i);
     }
 
     if constexpr( VEC_REMAINDER != 0 )
     {
-
-        output.remainder = this->mask_to_remainder(this->remainder >= v.remainder);
-
+        this->remainder /= expression.tail();
     }
-
-    return output;
 }
 
+/*!
+    Number used on one side of vector expression, it is broadcast to every block.
+*/
 template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator<=(const SIMDVectorLite<Size>& v) const
+class SIMDScalar
 {
-    SIMDVectorLite<Size> output;
+    number value;
 
-    for(size_t i=0;i<VEC_COUNT;++i)
+    public:
+
+    static constexpr size_t elements = Size;
+
+    SIMDScalar(number value)
     {
-        output._vec[i] = this->mask_to_simd(this->_vec[i] <= v._vec[i]);
+        this->value = value;
     }
 
-    if constexpr( VEC_REMAINDER != 0 )
+    SIMD block(size_t i) const
     {
+        return SIMD(this->value);
+    }
 
-        output.remainder = this->mask_to_remainder(this->remainder <= v.remainder);
-
+    auto tail() const
+    {
+        return std::experimental::fixed_size_simd<number,VEC_REMAINDER>(this->value);
     }
+};
 
-    return output;
-}
+/*!
+    Lazy result of arithmetic on SIMDVectorLite. Operators build a tree of these
+    and nothing is computed until it is assigned to a vector or reduced, then the
+    whole tree is evaluated block by block in one loop.
 
-template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator>(const SIMDVectorLite<Size>& v) const
+    Left and Right are simd_operand_t, named vectors are kept by reference so
+    expression must not outlive them.
+*/
+template<class Op,class Left,class Right>
+class SIMDExpression
 {
-    SIMDVectorLite<Size> output;
+    Left left;
 
-    for(size_t i=0;i<VEC_COUNT;++i)
+    Right right;
+
+    template<class T>
+    static decltype(auto) block_of(const T& operand,size_t i)
     {
-        output._vec[i] = this->mask_to_simd(this->_vec[i] > v._vec[i]);
+        if constexpr( is_simd_operand<T>::value && !is_simd_expression<T>::value )
+        {
+            return ( operand._vec[i] );
+        }
+        else
+        {
+            return operand.block(i);
+        }
     }
 
-    if constexpr( VEC_REMAINDER != 0 )
+    template<class T>
+    static decltype(auto) tail_of(const T& operand)
     {
+        if constexpr( is_simd_operand<T>::value && !is_simd_expression<T>::value )
+        {
+            return ( operand.remainder );
+        }
+        else
+        {
+            return operand.tail();
+        }
+    }
 
-        output.remainder = this->mask_to_remainder(this->remainder > v.remainder);
+    public:
 
-    }
+    static constexpr size_t elements = simd_elements<Left>;
 
-    return output;
-}
+    static_assert(simd_elements<Left> == simd_elements<Right>,"SIMDVectorLite expression size mismatch");
 
-template<size_t Size>
-SIMDVectorLite<Size> SIMDVectorLite<Size>::operator<(const SIMDVectorLite<Size>& v) const
-{
-    SIMDVectorLite<Size> output;
+    template<class L,class R>
+    SIMDExpression(L&& left,R&& right)
+    : left(std::forward<L>(left)),
+    right(std::forward<R>(right))
+    {
+    }
 
-    for(size_t i=0;i<VEC_COUNT;++i)
+    SIMD block(size_t i) const
     {
-        output._vec[i] = this->mask_to_simd(this->_vec[i] < v._vec[i]);
+        return Op::apply(block_of(this->left,i),block_of(this->right,i));
     }
 
-    if constexpr( VEC_REMAINDER != 0 )
+    auto tail() const
     {
+        return Op::apply(tail_of(this->left),tail_of(this->right));
+    }
 
-        output.remainder = this->mask_to_remainder(this->remainder < v.remainder);
+    number operator[](size_t i) const
+    {
+        constexpr size_t Size = elements;
 
+        if constexpr( VEC_REMAINDER != 0 )
+        {
+            if( i >= VEC_COUNT*MAX_SIMD_VECTOR_SIZE )
+            {
+                return this->tail()[i - VEC_COUNT*MAX_SIMD_VECTOR_SIZE];
+            }
+        }
+
+        return this->block(i/MAX_SIMD_VECTOR_SIZE)[i%MAX_SIMD_VECTOR_SIZE];
     }
 
-    return output;
-}
+    number reduce() const
+    {
+        constexpr size_t Size = elements;
 
-template<size_t Size>
-SIMDVectorLite<Size>::~SIMDVectorLite()
-{
-}
+        number output = 0;
 
-template<size_t Size>
-snn::SIMDVectorLite<Size> snn::SIMDVectorLite<Size>::exp()
-{
+        for(size_t i=0;i<VEC_COUNT;++i)
+        {
+            output += std::experimental::reduce(this->block(i));
+        }
 
-    snn::SIMDVectorLite<Size> output(0.f);
+        if constexpr( VEC_REMAINDER != 0 )
+        {
+            output += std::experimental::reduce(this->tail());
+        }
 
-    for(size_t i=0;i<VEC_COUNT;++i)
-    {
-        output._vec[i] = std::experimental::exp(this->_vec[i]);
+        return output;
     }
+};
 
-    if constexpr( VEC_REMAINDER != 0 )
+struct SIMDAdd
+{
+    template<class A,class B>
+    static auto apply(const A& a,const B& b)
     {
+        return a + b;
+    }
+};
 
-        output.remainder = std::experimental::exp(this->remainder);
+struct SIMDSubtract
+{
+    template<class A,class B>
+    static auto apply(const A& a,const B& b)
+    {
+        return a - b;
+    }
+};
 
+struct SIMDMultiply
+{
+    template<class A,class B>
+    static auto apply(const A& a,const B& b)
+    {
+        return a * b;
     }
+};
 
-    return output;
-}
+struct SIMDDivide
+{
+    template<class A,class B>
+    static auto apply(const A& a,const B& b)
+    {
+        return a / b;
+    }
+};
 
 }
 
@@ -969,27 +1425,32 @@ std::ostream& operator<<(std::ostream& out,const snn::SIMDVectorLite<Size>& vec)
     return out;
 }
 
-template<size_t Size>
-snn::SIMDVectorLite<Size> operator+(float num,const snn::SIMDVectorLite<Size>& vec)
-{
-    return vec+num;
+// global like operators of SIMDVector, every operator works for vector or expression on both sides, and with number on either side
+#define SIMD_EXPRESSION_OPERATOR(symbol,Op) \
+template<snn::SIMDOperand Left,snn::SIMDOperand Right> \
+snn::SIMDExpression<Op,snn::simd_operand_t<Left>,snn::simd_operand_t<Right>> operator symbol(Left&& left,Right&& right) \
+{ \
+    return snn::SIMDExpression<Op,snn::simd_operand_t<Left>,snn::simd_operand_t<Right>>(std::forward<Left>(left),std::forward<Right>(right)); \
+} \
+\
+template<snn::SIMDOperand Left> \
+snn::SIMDExpression<Op,snn::simd_operand_t<Left>,snn::SIMDScalar<snn::simd_elements<Left>>> operator symbol(Left&& left,number right) \
+{ \
+    return snn::SIMDExpression<Op,snn::simd_operand_t<Left>,snn::SIMDScalar<snn::simd_elements<Left>>>(std::forward<Left>(left),snn::SIMDScalar<snn::simd_elements<Left>>(right)); \
+} \
+\
+template<snn::SIMDOperand Right> \
+snn::SIMDExpression<Op,snn::SIMDScalar<snn::simd_elements<Right>>,snn::simd_operand_t<Right>> operator symbol(number left,Right&& right) \
+{ \
+    return snn::SIMDExpression<Op,snn::SIMDScalar<snn::simd_elements<Right>>,snn::simd_operand_t<Right>>(snn::SIMDScalar<snn::simd_elements<Right>>(left),std::forward<Right>(right)); \
 }
 
-template<size_t Size>
-snn::SIMDVectorLite<Size> operator-(float num,const snn::SIMDVectorLite<Size>& vec)
-{
-    return (vec*-1.f)+num;
-}
+SIMD_EXPRESSION_OPERATOR(+,snn::SIMDAdd)
 
-template<size_t Size>
-snn::SIMDVectorLite<Size> operator*(float num,const snn::SIMDVectorLite<Size>& vec)
-{
-    return vec*num;
-}
+SIMD_EXPRESSION_OPERATOR(-,snn::SIMDSubtract)
 
-template<size_t Size>
-snn::SIMDVectorLite<Size> operator/(float num,const snn::SIMDVectorLite<Size>& vec)
-{
-    return vec*num/(vec*vec);
-}
+SIMD_EXPRESSION_OPERATOR(*,snn::SIMDMultiply)
+
+SIMD_EXPRESSION_OPERATOR(/,snn::SIMDDivide)
 
+#undef SIMD_EXPRESSION_OPERATOR
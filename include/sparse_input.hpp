@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <simd_vector_lite.hpp>
+#include <config.hpp>
+
+namespace snn
+{
+    /*!
+        Input vector where most of values are equal to background value, only the
+        other ones are stored, as list of thier indexes and values.
+    */
+    template<size_t Size>
+    class SparseInput
+    {
+        protected:
+
+        number background;
+
+        std::vector<uint32_t> indexes;
+
+        std::vector<number> values;
+
+        public:
+
+        SparseInput( number background = 0.f )
+        {
+            this->background = background;
+        }
+
+        /*!
+            Fill from dense vector, values closer to background than tolerance are
+            treated as background.
+        */
+        void assign(const SIMDVectorLite<Size>& input,number tolerance = 0.f)
+        {
+            alignas(SPLINE_NODE_ALIGNMENT) number dense[Size];
+
+            input.copy_to(dense);
+
+            this->indexes.clear();
+            this->values.clear();
+
+            for(size_t i=0;i<Size;++i)
+            {
+                if( abs( dense[i] - this->background ) > tolerance )
+                {
+                    this->indexes.push_back(i);
+                    this->values.push_back(dense[i]);
+                }
+            }
+        }
+
+        void clear()
+        {
+            this->indexes.clear();
+            this->values.clear();
+        }
+
+        /*!
+            Add value at index, indexes have to be added in ascending order.
+        */
+        void push(uint32_t index,number value)
+        {
+            this->indexes.push_back(index);
+            this->values.push_back(value);
+        }
+
+        number get_background() const
+        {
+            return this->background;
+        }
+
+        const uint32_t* get_indexes() const
+        {
+            return this->indexes.data();
+        }
+
+        const number* get_values() const
+        {
+            return this->values.data();
+        }
+
+        size_t length() const
+        {
+            return this->indexes.size();
+        }
+
+        number density() const
+        {
+            return static_cast<number>(this->indexes.size())/Size;
+        }
+
+    };
+
+}
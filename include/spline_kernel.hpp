@@ -0,0 +1,1006 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <static_kan_spline.hpp>
+#include <half_number.hpp>
+#include <evo_kan_spline_grid.hpp>
+#include <evo_kan_spline_quantized.hpp>
+#include <simd_dispatch.hpp>
+#include <config.hpp>
+
+namespace snn
+{
+    /*!
+        Vectorized evaluation of many splines stored in one contiguous array.
+
+        Each SIMD lane handles other spline (or other sample of one spline in
+        fire_column), segments are found with branchless search over node indexes and
+        node values are loaded with AVX-512 or AVX2 gathers. Both versions are built
+        with target attributes and fire picks one by simd_level() at runtime, on CPUs
+        without gathers the same search runs lane by lane.
+
+        Only spline classes with fixed layout have a kernel, for the rest available is
+        false and EvoKan uses generic path.
+    */
+    template<class SplineClass>
+    struct SplineKernel
+    {
+        static constexpr bool available = false;
+    };
+
+#if defined(SNN_SIMD_DISPATCH)
+
+    // masked gather with zeroed source, plain one leaves source undefined, for the
+    // same reason AVX-512 kernels use maskz forms of shifts and conversions with all
+    // lanes set, plain ones pass undefined source that gcc reports at -O2
+    SNN_TARGET_AVX512 inline __m512 gather(const number* base,__m512i index)
+    {
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(),0xFFFF,index,base,4);
+    }
+
+#endif
+
+    /*!
+        Horizontal sum of a SIMD accumulator.
+    */
+#if defined(SNN_SIMD_DISPATCH)
+
+    SNN_TARGET_AVX512 inline number lane_sum(__m512 acc)
+    {
+        alignas(64) number lanes[16];
+
+        _mm512_store_ps(lanes,acc);
+
+        number sum = 0.f;
+
+        for(number lane : lanes)
+        {
+            sum += lane;
+        }
+
+        return sum;
+    }
+
+    SNN_TARGET_AVX2 inline number lane_sum(__m256 acc)
+    {
+        alignas(32) number lanes[8];
+
+        _mm256_store_ps(lanes,acc);
+
+        number sum = 0.f;
+
+        for(number lane : lanes)
+        {
+            sum += lane;
+        }
+
+        return sum;
+    }
+
+#endif
+
+    /*!
+        Loads nodes kept as Storage into SIMD registers of number, index counts
+        Storage values. 16 bit values are read with 32 bit gathers, low() reads node
+        together with the next one and high() together with the previous one. x of
+        SplineStatic is followed by y and y is preceded by x, so low() is used for x
+        and high() for y, and no read leaves the spline.
+    */
+    template<class Storage>
+    struct NodeLoad
+    {
+        static constexpr bool available = false;
+    };
+
+    template<>
+    struct NodeLoad<float>
+    {
+        static constexpr bool available = true;
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static __m512 low(const float* base,__m512i index)
+        {
+            return gather(base,index);
+        }
+
+        SNN_TARGET_AVX512 static __m512 high(const float* base,__m512i index)
+        {
+            return gather(base,index);
+        }
+
+        SNN_TARGET_AVX2 static __m256 low(const float* base,__m256i index)
+        {
+            return _mm256_i32gather_ps(base,index,4);
+        }
+
+        SNN_TARGET_AVX2 static __m256 high(const float* base,__m256i index)
+        {
+            return _mm256_i32gather_ps(base,index,4);
+        }
+
+#endif
+
+    };
+
+    template<>
+    struct NodeLoad<bfloat16>
+    {
+        static constexpr bool available = true;
+
+        // bfloat16 is upper half of float, so it only has to be moved there
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static __m512 low(const bfloat16* base,__m512i index)
+        {
+            const __m512i pair = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(),0xFFFF,index,base,2);
+
+            return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xFFFF,pair,16));
+        }
+
+        SNN_TARGET_AVX512 static __m512 high(const bfloat16* base,__m512i index)
+        {
+            const __m512i pair = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(),0xFFFF,_mm512_sub_epi32(index,_mm512_set1_epi32(1)),base,2);
+
+            return _mm512_castsi512_ps(_mm512_and_si512(pair,_mm512_set1_epi32(0xFFFF0000)));
+        }
+
+        SNN_TARGET_AVX2 static __m256 low(const bfloat16* base,__m256i index)
+        {
+            const __m256i pair = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base),index,2);
+
+            return _mm256_castsi256_ps(_mm256_slli_epi32(pair,16));
+        }
+
+        SNN_TARGET_AVX2 static __m256 high(const bfloat16* base,__m256i index)
+        {
+            const __m256i pair = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base),_mm256_sub_epi32(index,_mm256_set1_epi32(1)),2);
+
+            return _mm256_castsi256_ps(_mm256_and_si256(pair,_mm256_set1_epi32(0xFFFF0000)));
+        }
+
+#endif
+
+    };
+
+#if defined(__FLT16_MAX__)
+
+    template<>
+    struct NodeLoad<half>
+    {
+        // AVX2 version is used only on CPUs with F16C, which are required by SIMDLevel::AVX2
+        static constexpr bool available = true;
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static __m512 low(const half* base,__m512i index)
+        {
+            const __m512i pair = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(),0xFFFF,index,base,2);
+
+            return _mm512_maskz_cvtph_ps(0xFFFF,_mm512_maskz_cvtepi32_epi16(0xFFFF,pair));
+        }
+
+        SNN_TARGET_AVX512 static __m512 high(const half* base,__m512i index)
+        {
+            const __m512i pair = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(),0xFFFF,_mm512_sub_epi32(index,_mm512_set1_epi32(1)),base,2);
+
+            return _mm512_maskz_cvtph_ps(0xFFFF,_mm512_maskz_cvtepi32_epi16(0xFFFF,_mm512_maskz_srli_epi32(0xFFFF,pair,16)));
+        }
+
+        // values have to be below 0x10000 before they are packed
+        SNN_TARGET_AVX2 static __m256 convert(__m256i values)
+        {
+            return _mm256_cvtph_ps(_mm_packus_epi32(_mm256_castsi256_si128(values),_mm256_extracti128_si256(values,1)));
+        }
+
+        SNN_TARGET_AVX2 static __m256 low(const half* base,__m256i index)
+        {
+            const __m256i pair = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base),index,2);
+
+            return convert(_mm256_and_si256(pair,_mm256_set1_epi32(0xFFFF)));
+        }
+
+        SNN_TARGET_AVX2 static __m256 high(const half* base,__m256i index)
+        {
+            const __m256i pair = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base),_mm256_sub_epi32(index,_mm256_set1_epi32(1)),2);
+
+            return convert(_mm256_srli_epi32(pair,16));
+        }
+
+#endif
+
+    };
+
+#endif
+
+    template<size_t Size,class Storage>
+    struct SplineKernel<SplineStatic<Size,Storage>>
+    {
+        static constexpr bool available = std::is_same_v<number,float> && NodeLoad<Storage>::available;
+
+        // distance in stored values between nodes of neighbouring splines in array
+        static constexpr int32_t stride = sizeof(SplineStatic<Size,Storage>)/sizeof(Storage);
+
+        // biggest power of two below Size, first step of search
+        static constexpr int32_t first_step = std::bit_floor(Size-1);
+
+        static number fire(const Storage* nodes_x,const Storage* nodes_y,number x)
+        {
+            const size_t p = std::min<size_t>(SplineStatic<Size,Storage>::lower_node(nodes_x,x),Size-2);
+
+            const number x_left = nodes_x[p];
+            const number x_right = nodes_x[p+1];
+
+            // outside of nodes spline returns 0
+            if( x < x_left || x > x_right )
+            {
+                return 0.f;
+            }
+
+            const number dx = x_right - x_left;
+
+            const number y_left = nodes_y[p];
+            const number y_right = nodes_y[p+1];
+
+            if( dx == 0.f )
+            {
+                return y_left;
+            }
+
+            return ( y_right - y_left )/dx*( x - x_left ) + y_left;
+        }
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static __m512 fire(const Storage* base_x,const Storage* base_y,__m512i lane,__m512 x)
+        {
+            __m512i p = _mm512_setzero_si512();
+
+            const __m512i last = _mm512_set1_epi32(Size-1);
+
+            for(int32_t step=first_step;step>0;step>>=1)
+            {
+                const __m512i candidate = _mm512_add_epi32(p,_mm512_set1_epi32(step));
+
+                const __m512 node = NodeLoad<Storage>::low(base_x,_mm512_add_epi32(lane,_mm512_maskz_min_epi32(0xFFFF,candidate,last)));
+
+                const __mmask16 move = _mm512_cmple_epi32_mask(candidate,last) & _mm512_cmp_ps_mask(node,x,_CMP_LE_OQ);
+
+                p = _mm512_mask_blend_epi32(move,p,candidate);
+            }
+
+            p = _mm512_add_epi32(lane,_mm512_maskz_min_epi32(0xFFFF,p,_mm512_set1_epi32(Size-2)));
+
+            const __m512i q = _mm512_add_epi32(p,_mm512_set1_epi32(1));
+
+            const __m512 x_left = NodeLoad<Storage>::low(base_x,p);
+            const __m512 x_right = NodeLoad<Storage>::low(base_x,q);
+
+            const __m512 y_left = NodeLoad<Storage>::high(base_y,p);
+            const __m512 y_right = NodeLoad<Storage>::high(base_y,q);
+
+            const __m512 dx = _mm512_sub_ps(x_right,x_left);
+
+            const __mmask16 flat = _mm512_cmp_ps_mask(dx,_mm512_setzero_ps(),_CMP_EQ_OQ);
+
+            const __m512 a = _mm512_div_ps(_mm512_sub_ps(y_right,y_left),_mm512_mask_blend_ps(flat,dx,_mm512_set1_ps(1.f)));
+
+            const __m512 value = _mm512_fmadd_ps(_mm512_maskz_mov_ps(~flat,a),_mm512_sub_ps(x,x_left),y_left);
+
+            const __mmask16 inside = _mm512_cmp_ps_mask(x,x_left,_CMP_GE_OQ) & _mm512_cmp_ps_mask(x,x_right,_CMP_LE_OQ);
+
+            return _mm512_maskz_mov_ps(inside,value);
+        }
+
+        SNN_TARGET_AVX2 static __m256 fire(const Storage* base_x,const Storage* base_y,__m256i lane,__m256 x)
+        {
+            __m256i p = _mm256_setzero_si256();
+
+            const __m256i last = _mm256_set1_epi32(Size-1);
+
+            for(int32_t step=first_step;step>0;step>>=1)
+            {
+                const __m256i candidate = _mm256_add_epi32(p,_mm256_set1_epi32(step));
+
+                const __m256 node = NodeLoad<Storage>::low(base_x,_mm256_add_epi32(lane,_mm256_min_epi32(candidate,last)));
+
+                const __m256i in_range = _mm256_cmpgt_epi32(_mm256_set1_epi32(Size),candidate);
+
+                const __m256i move = _mm256_and_si256(in_range,_mm256_castps_si256(_mm256_cmp_ps(node,x,_CMP_LE_OQ)));
+
+                p = _mm256_blendv_epi8(p,candidate,move);
+            }
+
+            p = _mm256_add_epi32(lane,_mm256_min_epi32(p,_mm256_set1_epi32(Size-2)));
+
+            const __m256i q = _mm256_add_epi32(p,_mm256_set1_epi32(1));
+
+            const __m256 x_left = NodeLoad<Storage>::low(base_x,p);
+            const __m256 x_right = NodeLoad<Storage>::low(base_x,q);
+
+            const __m256 y_left = NodeLoad<Storage>::high(base_y,p);
+            const __m256 y_right = NodeLoad<Storage>::high(base_y,q);
+
+            const __m256 dx = _mm256_sub_ps(x_right,x_left);
+
+            const __m256 flat = _mm256_cmp_ps(dx,_mm256_setzero_ps(),_CMP_EQ_OQ);
+
+            const __m256 a = _mm256_andnot_ps(flat,_mm256_div_ps(_mm256_sub_ps(y_right,y_left),_mm256_blendv_ps(dx,_mm256_set1_ps(1.f),flat)));
+
+            const __m256 value = _mm256_fmadd_ps(a,_mm256_sub_ps(x,x_left),y_left);
+
+            const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(x,x_left,_CMP_GE_OQ),_mm256_cmp_ps(x,x_right,_CMP_LE_OQ));
+
+            return _mm256_and_ps(inside,value);
+        }
+
+#endif
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static number fire_avx512(const SplineStatic<Size,Storage>* splines,const number* input,size_t count)
+        {
+            const Storage* base_x = splines[0].get_x();
+            const Storage* base_y = splines[0].get_y();
+
+            const __m512i iota = _mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+
+            __m512 acc = _mm512_setzero_ps();
+
+            size_t i = 0;
+
+            for(;i<count - count%16;i+=16)
+            {
+                const __m512i lane = _mm512_mullo_epi32(_mm512_add_epi32(iota,_mm512_set1_epi32(i)),_mm512_set1_epi32(stride));
+
+                acc = _mm512_add_ps(acc,fire(base_x,base_y,lane,_mm512_loadu_ps(input+i)));
+            }
+
+            number sum = lane_sum(acc);
+
+            // less than a register is left, gcc sees that tail is short and bounded
+            if( i < count )
+            {
+                sum += fire_generic(splines,input,i,count);
+            }
+
+            return sum;
+        }
+
+        SNN_TARGET_AVX2 static number fire_avx2(const SplineStatic<Size,Storage>* splines,const number* input,size_t count)
+        {
+            const Storage* base_x = splines[0].get_x();
+            const Storage* base_y = splines[0].get_y();
+
+            const __m256i iota = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+
+            __m256 acc = _mm256_setzero_ps();
+
+            size_t i = 0;
+
+            for(;i<count - count%8;i+=8)
+            {
+                const __m256i lane = _mm256_mullo_epi32(_mm256_add_epi32(iota,_mm256_set1_epi32(i)),_mm256_set1_epi32(stride));
+
+                acc = _mm256_add_ps(acc,fire(base_x,base_y,lane,_mm256_loadu_ps(input+i)));
+            }
+
+            number sum = lane_sum(acc);
+
+            // less than a register is left, gcc sees that tail is short and bounded
+            if( i < count )
+            {
+                sum += fire_generic(splines,input,i,count);
+            }
+
+            return sum;
+        }
+
+        SNN_TARGET_AVX512 static void fire_column_avx512(const SplineStatic<Size,Storage>& spline,const number* column,size_t count,number* outputs)
+        {
+            const Storage* nodes_x = spline.get_x();
+            const Storage* nodes_y = spline.get_y();
+
+            size_t s = 0;
+
+            for(;s<count - count%16;s+=16)
+            {
+                const __m512 value = fire(nodes_x,nodes_y,_mm512_setzero_si512(),_mm512_loadu_ps(column+s));
+
+                _mm512_storeu_ps(outputs+s,_mm512_add_ps(_mm512_loadu_ps(outputs+s),value));
+            }
+
+            if( s < count )
+            {
+                fire_column_generic(spline,column,s,count,outputs);
+            }
+        }
+
+        SNN_TARGET_AVX2 static void fire_column_avx2(const SplineStatic<Size,Storage>& spline,const number* column,size_t count,number* outputs)
+        {
+            const Storage* nodes_x = spline.get_x();
+            const Storage* nodes_y = spline.get_y();
+
+            size_t s = 0;
+
+            for(;s<count - count%8;s+=8)
+            {
+                const __m256 value = fire(nodes_x,nodes_y,_mm256_setzero_si256(),_mm256_loadu_ps(column+s));
+
+                _mm256_storeu_ps(outputs+s,_mm256_add_ps(_mm256_loadu_ps(outputs+s),value));
+            }
+
+            if( s < count )
+            {
+                fire_column_generic(spline,column,s,count,outputs);
+            }
+        }
+
+#endif
+
+        /*!
+            Lane by lane version of fire, for i from begin below count.
+        */
+        static number fire_generic(const SplineStatic<Size,Storage>* splines,const number* input,size_t begin,size_t count)
+        {
+            number sum = 0.f;
+
+            for(size_t i=begin;i<count;++i)
+            {
+                sum += fire(splines[i].get_x(),splines[i].get_y(),input[i]);
+            }
+
+            return sum;
+        }
+
+        static void fire_column_generic(const SplineStatic<Size,Storage>& spline,const number* column,size_t begin,size_t count,number* outputs)
+        {
+            const Storage* nodes_x = spline.get_x();
+            const Storage* nodes_y = spline.get_y();
+
+            for(size_t s=begin;s<count;++s)
+            {
+                outputs[s] += fire(nodes_x,nodes_y,column[s]);
+            }
+        }
+
+        /*!
+            Sum of splines[i] at input[i] for i below count.
+        */
+        static number fire(const SplineStatic<Size,Storage>* splines,const number* input,size_t count)
+        {
+#if defined(SNN_SIMD_DISPATCH)
+
+            switch( simd_level() )
+            {
+                case SIMDLevel::AVX512:
+                    return fire_avx512(splines,input,count);
+
+                case SIMDLevel::AVX2:
+                    return fire_avx2(splines,input,count);
+
+                default:
+                    break;
+            }
+
+#endif
+
+            return fire_generic(splines,input,0,count);
+        }
+
+        /*!
+            Add value of spline at column[s] to outputs[s] for s below count.
+        */
+        static void fire_column(const SplineStatic<Size,Storage>& spline,const number* column,size_t count,number* outputs)
+        {
+#if defined(SNN_SIMD_DISPATCH)
+
+            switch( simd_level() )
+            {
+                case SIMDLevel::AVX512:
+                    return fire_column_avx512(spline,column,count,outputs);
+
+                case SIMDLevel::AVX2:
+                    return fire_column_avx2(spline,column,count,outputs);
+
+                default:
+                    break;
+            }
+
+#endif
+
+            fire_column_generic(spline,column,0,count,outputs);
+        }
+
+    };
+
+    template<size_t Resolution>
+    struct SplineKernel<SplineGrid<Resolution>>
+    {
+        static constexpr bool available = std::is_same_v<number,float>;
+
+        static constexpr int32_t stride = sizeof(SplineGrid<Resolution>)/sizeof(number);
+
+        // offsets of grid fields from start of spline, in numbers
+        static constexpr int32_t x_min_offset = offsetof(SplineGrid<Resolution>,x_min)/sizeof(number);
+        static constexpr int32_t x_max_offset = offsetof(SplineGrid<Resolution>,x_max)/sizeof(number);
+        static constexpr int32_t inv_step_offset = offsetof(SplineGrid<Resolution>,inv_step)/sizeof(number);
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static __m512 fire(const number* base,__m512i lane,__m512 x)
+        {
+            const __m512 x_min = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(x_min_offset)));
+            const __m512 x_max = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(x_max_offset)));
+            const __m512 inv_step = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(inv_step_offset)));
+
+            const __mmask16 inside = _mm512_cmp_ps_mask(x,x_min,_CMP_GE_OQ) & _mm512_cmp_ps_mask(x,x_max,_CMP_LE_OQ);
+
+            // lanes outside of range are clamped to first cell and masked out at the end
+            __m512i id = _mm512_maskz_cvttps_epi32(inside,_mm512_mul_ps(_mm512_sub_ps(x,x_min),inv_step));
+
+            id = _mm512_maskz_min_epi32(0xFFFF,id,_mm512_set1_epi32(Resolution-1));
+
+            const __m512i line = _mm512_add_epi32(lane,_mm512_maskz_slli_epi32(0xFFFF,id,1));
+
+            const __m512 slope = gather(base,line);
+            const __m512 intercept = gather(base,_mm512_add_epi32(line,_mm512_set1_epi32(1)));
+
+            return _mm512_maskz_mov_ps(inside,_mm512_fmadd_ps(slope,x,intercept));
+        }
+
+        SNN_TARGET_AVX2 static __m256 fire(const number* base,__m256i lane,__m256 x)
+        {
+            const __m256 x_min = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(x_min_offset)),4);
+            const __m256 x_max = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(x_max_offset)),4);
+            const __m256 inv_step = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(inv_step_offset)),4);
+
+            const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(x,x_min,_CMP_GE_OQ),_mm256_cmp_ps(x,x_max,_CMP_LE_OQ));
+
+            __m256i id = _mm256_cvttps_epi32(_mm256_and_ps(inside,_mm256_mul_ps(_mm256_sub_ps(x,x_min),inv_step)));
+
+            id = _mm256_min_epi32(id,_mm256_set1_epi32(Resolution-1));
+
+            const __m256i line = _mm256_add_epi32(lane,_mm256_slli_epi32(id,1));
+
+            const __m256 slope = _mm256_i32gather_ps(base,line,4);
+            const __m256 intercept = _mm256_i32gather_ps(base,_mm256_add_epi32(line,_mm256_set1_epi32(1)),4);
+
+            return _mm256_and_ps(inside,_mm256_fmadd_ps(slope,x,intercept));
+        }
+
+#endif
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static number fire_avx512(const SplineGrid<Resolution>* splines,const number* input,size_t count)
+        {
+            const number* base = reinterpret_cast<const number*>(splines);
+
+            const __m512i iota = _mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+
+            __m512 acc = _mm512_setzero_ps();
+
+            size_t i = 0;
+
+            for(;i<count - count%16;i+=16)
+            {
+                const __m512i lane = _mm512_mullo_epi32(_mm512_add_epi32(iota,_mm512_set1_epi32(i)),_mm512_set1_epi32(stride));
+
+                acc = _mm512_add_ps(acc,fire(base,lane,_mm512_loadu_ps(input+i)));
+            }
+
+            number sum = lane_sum(acc);
+
+            // less than a register is left, gcc sees that tail is short and bounded
+            if( i < count )
+            {
+                sum += fire_generic(splines,input,i,count);
+            }
+
+            return sum;
+        }
+
+        SNN_TARGET_AVX2 static number fire_avx2(const SplineGrid<Resolution>* splines,const number* input,size_t count)
+        {
+            const number* base = reinterpret_cast<const number*>(splines);
+
+            const __m256i iota = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+
+            __m256 acc = _mm256_setzero_ps();
+
+            size_t i = 0;
+
+            for(;i<count - count%8;i+=8)
+            {
+                const __m256i lane = _mm256_mullo_epi32(_mm256_add_epi32(iota,_mm256_set1_epi32(i)),_mm256_set1_epi32(stride));
+
+                acc = _mm256_add_ps(acc,fire(base,lane,_mm256_loadu_ps(input+i)));
+            }
+
+            number sum = lane_sum(acc);
+
+            // less than a register is left, gcc sees that tail is short and bounded
+            if( i < count )
+            {
+                sum += fire_generic(splines,input,i,count);
+            }
+
+            return sum;
+        }
+
+        SNN_TARGET_AVX512 static void fire_column_avx512(const SplineGrid<Resolution>& spline,const number* column,size_t count,number* outputs)
+        {
+            const number* base = reinterpret_cast<const number*>(&spline);
+
+            size_t s = 0;
+
+            for(;s<count - count%16;s+=16)
+            {
+                const __m512 value = fire(base,_mm512_setzero_si512(),_mm512_loadu_ps(column+s));
+
+                _mm512_storeu_ps(outputs+s,_mm512_add_ps(_mm512_loadu_ps(outputs+s),value));
+            }
+
+            if( s < count )
+            {
+                fire_column_generic(spline,column,s,count,outputs);
+            }
+        }
+
+        SNN_TARGET_AVX2 static void fire_column_avx2(const SplineGrid<Resolution>& spline,const number* column,size_t count,number* outputs)
+        {
+            const number* base = reinterpret_cast<const number*>(&spline);
+
+            size_t s = 0;
+
+            for(;s<count - count%8;s+=8)
+            {
+                const __m256 value = fire(base,_mm256_setzero_si256(),_mm256_loadu_ps(column+s));
+
+                _mm256_storeu_ps(outputs+s,_mm256_add_ps(_mm256_loadu_ps(outputs+s),value));
+            }
+
+            if( s < count )
+            {
+                fire_column_generic(spline,column,s,count,outputs);
+            }
+        }
+
+#endif
+
+        /*!
+            Lane by lane version of fire, for i from begin below count.
+        */
+        static number fire_generic(const SplineGrid<Resolution>* splines,const number* input,size_t begin,size_t count)
+        {
+            number sum = 0.f;
+
+            for(size_t i=begin;i<count;++i)
+            {
+                sum += splines[i].fire(input[i]);
+            }
+
+            return sum;
+        }
+
+        static void fire_column_generic(const SplineGrid<Resolution>& spline,const number* column,size_t begin,size_t count,number* outputs)
+        {
+            for(size_t s=begin;s<count;++s)
+            {
+                outputs[s] += spline.fire(column[s]);
+            }
+        }
+
+        /*!
+            Sum of splines[i] at input[i] for i below count.
+        */
+        static number fire(const SplineGrid<Resolution>* splines,const number* input,size_t count)
+        {
+#if defined(SNN_SIMD_DISPATCH)
+
+            switch( simd_level() )
+            {
+                case SIMDLevel::AVX512:
+                    return fire_avx512(splines,input,count);
+
+                case SIMDLevel::AVX2:
+                    return fire_avx2(splines,input,count);
+
+                default:
+                    break;
+            }
+
+#endif
+
+            return fire_generic(splines,input,0,count);
+        }
+
+        /*!
+            Add value of spline at column[s] to outputs[s] for s below count.
+        */
+        static void fire_column(const SplineGrid<Resolution>& spline,const number* column,size_t count,number* outputs)
+        {
+#if defined(SNN_SIMD_DISPATCH)
+
+            switch( simd_level() )
+            {
+                case SIMDLevel::AVX512:
+                    return fire_column_avx512(spline,column,count,outputs);
+
+                case SIMDLevel::AVX2:
+                    return fire_column_avx2(spline,column,count,outputs);
+
+                default:
+                    break;
+            }
+
+#endif
+
+            fire_column_generic(spline,column,0,count,outputs);
+        }
+
+    };
+
+    template<size_t Resolution,class Value>
+    struct SplineKernel<SplineQuantized<Resolution,Value>>
+    {
+        typedef SplineQuantized<Resolution,Value> Quantized;
+
+        static constexpr bool available = std::is_same_v<number,float>;
+
+        static constexpr int32_t stride = sizeof(Quantized)/sizeof(number);
+
+        static_assert(sizeof(Quantized)%sizeof(number) == 0,"SplineQuantized has to be made of whole numbers");
+
+        static constexpr int32_t x_min_offset = offsetof(Quantized,x_min)/sizeof(number);
+        static constexpr int32_t x_max_offset = offsetof(Quantized,x_max)/sizeof(number);
+        static constexpr int32_t inv_step_offset = offsetof(Quantized,inv_step)/sizeof(number);
+        static constexpr int32_t scale_offset = offsetof(Quantized,scale)/sizeof(number);
+        static constexpr int32_t offset_offset = offsetof(Quantized,offset)/sizeof(number);
+
+        // in bytes, values are gathered with byte indexes
+        static constexpr int32_t values_offset = offsetof(Quantized,values);
+
+        // how far value has to be shifted left, so its sign bit becomes top bit of lane
+        static constexpr int32_t value_shift = 32 - 8*sizeof(Value);
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static __m512 fire(const number* base,__m512i lane,__m512 x)
+        {
+            const __m512 x_min = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(x_min_offset)));
+            const __m512 x_max = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(x_max_offset)));
+            const __m512 inv_step = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(inv_step_offset)));
+
+            const __mmask16 inside = _mm512_cmp_ps_mask(x,x_min,_CMP_GE_OQ) & _mm512_cmp_ps_mask(x,x_max,_CMP_LE_OQ);
+
+            const __m512 position = _mm512_maskz_mul_ps(inside,_mm512_sub_ps(x,x_min),inv_step);
+
+            const __m512i id = _mm512_maskz_min_epi32(0xFFFF,_mm512_maskz_cvttps_epi32(0xFFFF,position),_mm512_set1_epi32(Resolution-1));
+
+            const __m512 t = _mm512_sub_ps(position,_mm512_maskz_cvtepi32_ps(0xFFFF,id));
+
+            // one 32 bit load brings both points of a cell, left one in low bits
+            const __m512i bytes = _mm512_add_epi32(_mm512_maskz_slli_epi32(0xFFFF,lane,2),_mm512_add_epi32(_mm512_set1_epi32(values_offset),_mm512_mullo_epi32(id,_mm512_set1_epi32(sizeof(Value)))));
+
+            const __m512i pair = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(),0xFFFF,bytes,base,1);
+
+            const __m512 left = _mm512_maskz_cvtepi32_ps(0xFFFF,_mm512_maskz_srai_epi32(0xFFFF,_mm512_maskz_slli_epi32(0xFFFF,pair,value_shift),value_shift));
+            const __m512 right = _mm512_maskz_cvtepi32_ps(0xFFFF,_mm512_maskz_srai_epi32(0xFFFF,_mm512_maskz_slli_epi32(0xFFFF,pair,value_shift - 8*sizeof(Value)),value_shift));
+
+            const __m512 scale = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(scale_offset)));
+            const __m512 offset = gather(base,_mm512_add_epi32(lane,_mm512_set1_epi32(offset_offset)));
+
+            const __m512 value = _mm512_fmadd_ps(t,_mm512_sub_ps(right,left),left);
+
+            return _mm512_maskz_mov_ps(inside,_mm512_fmadd_ps(scale,value,offset));
+        }
+
+        SNN_TARGET_AVX2 static __m256 fire(const number* base,__m256i lane,__m256 x)
+        {
+            const __m256 x_min = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(x_min_offset)),4);
+            const __m256 x_max = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(x_max_offset)),4);
+            const __m256 inv_step = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(inv_step_offset)),4);
+
+            const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(x,x_min,_CMP_GE_OQ),_mm256_cmp_ps(x,x_max,_CMP_LE_OQ));
+
+            const __m256 position = _mm256_and_ps(inside,_mm256_mul_ps(_mm256_sub_ps(x,x_min),inv_step));
+
+            const __m256i id = _mm256_min_epi32(_mm256_cvttps_epi32(position),_mm256_set1_epi32(Resolution-1));
+
+            const __m256 t = _mm256_sub_ps(position,_mm256_cvtepi32_ps(id));
+
+            const __m256i bytes = _mm256_add_epi32(_mm256_slli_epi32(lane,2),_mm256_add_epi32(_mm256_set1_epi32(values_offset),_mm256_mullo_epi32(id,_mm256_set1_epi32(sizeof(Value)))));
+
+            const __m256i pair = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base),bytes,1);
+
+            const __m256 left = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pair,value_shift),value_shift));
+            const __m256 right = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pair,value_shift - 8*sizeof(Value)),value_shift));
+
+            const __m256 scale = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(scale_offset)),4);
+            const __m256 offset = _mm256_i32gather_ps(base,_mm256_add_epi32(lane,_mm256_set1_epi32(offset_offset)),4);
+
+            const __m256 value = _mm256_fmadd_ps(t,_mm256_sub_ps(right,left),left);
+
+            return _mm256_and_ps(inside,_mm256_fmadd_ps(scale,value,offset));
+        }
+
+#endif
+
+#if defined(SNN_SIMD_DISPATCH)
+
+        SNN_TARGET_AVX512 static number fire_avx512(const Quantized* splines,const number* input,size_t count)
+        {
+            const number* base = reinterpret_cast<const number*>(splines);
+
+            const __m512i iota = _mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+
+            __m512 acc = _mm512_setzero_ps();
+
+            size_t i = 0;
+
+            for(;i<count - count%16;i+=16)
+            {
+                const __m512i lane = _mm512_mullo_epi32(_mm512_add_epi32(iota,_mm512_set1_epi32(i)),_mm512_set1_epi32(stride));
+
+                acc = _mm512_add_ps(acc,fire(base,lane,_mm512_loadu_ps(input+i)));
+            }
+
+            number sum = lane_sum(acc);
+
+            // less than a register is left, gcc sees that tail is short and bounded
+            if( i < count )
+            {
+                sum += fire_generic(splines,input,i,count);
+            }
+
+            return sum;
+        }
+
+        SNN_TARGET_AVX2 static number fire_avx2(const Quantized* splines,const number* input,size_t count)
+        {
+            const number* base = reinterpret_cast<const number*>(splines);
+
+            const __m256i iota = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+
+            __m256 acc = _mm256_setzero_ps();
+
+            size_t i = 0;
+
+            for(;i<count - count%8;i+=8)
+            {
+                const __m256i lane = _mm256_mullo_epi32(_mm256_add_epi32(iota,_mm256_set1_epi32(i)),_mm256_set1_epi32(stride));
+
+                acc = _mm256_add_ps(acc,fire(base,lane,_mm256_loadu_ps(input+i)));
+            }
+
+            number sum = lane_sum(acc);
+
+            // less than a register is left, gcc sees that tail is short and bounded
+            if( i < count )
+            {
+                sum += fire_generic(splines,input,i,count);
+            }
+
+            return sum;
+        }
+
+        SNN_TARGET_AVX512 static void fire_column_avx512(const Quantized& spline,const number* column,size_t count,number* outputs)
+        {
+            const number* base = reinterpret_cast<const number*>(&spline);
+
+            size_t s = 0;
+
+            for(;s<count - count%16;s+=16)
+            {
+                const __m512 value = fire(base,_mm512_setzero_si512(),_mm512_loadu_ps(column+s));
+
+                _mm512_storeu_ps(outputs+s,_mm512_add_ps(_mm512_loadu_ps(outputs+s),value));
+            }
+
+            if( s < count )
+            {
+                fire_column_generic(spline,column,s,count,outputs);
+            }
+        }
+
+        SNN_TARGET_AVX2 static void fire_column_avx2(const Quantized& spline,const number* column,size_t count,number* outputs)
+        {
+            const number* base = reinterpret_cast<const number*>(&spline);
+
+            size_t s = 0;
+
+            for(;s<count - count%8;s+=8)
+            {
+                const __m256 value = fire(base,_mm256_setzero_si256(),_mm256_loadu_ps(column+s));
+
+                _mm256_storeu_ps(outputs+s,_mm256_add_ps(_mm256_loadu_ps(outputs+s),value));
+            }
+
+            if( s < count )
+            {
+                fire_column_generic(spline,column,s,count,outputs);
+            }
+        }
+
+#endif
+
+        /*!
+            Lane by lane version of fire, for i from begin below count.
+        */
+        static number fire_generic(const Quantized* splines,const number* input,size_t begin,size_t count)
+        {
+            number sum = 0.f;
+
+            for(size_t i=begin;i<count;++i)
+            {
+                sum += splines[i].fire(input[i]);
+            }
+
+            return sum;
+        }
+
+        static void fire_column_generic(const Quantized& spline,const number* column,size_t begin,size_t count,number* outputs)
+        {
+            for(size_t s=begin;s<count;++s)
+            {
+                outputs[s] += spline.fire(column[s]);
+            }
+        }
+
+        /*!
+            Sum of splines[i] at input[i] for i below count.
+        */
+        static number fire(const Quantized* splines,const number* input,size_t count)
+        {
+#if defined(SNN_SIMD_DISPATCH)
+
+            switch( simd_level() )
+            {
+                case SIMDLevel::AVX512:
+                    return fire_avx512(splines,input,count);
+
+                case SIMDLevel::AVX2:
+                    return fire_avx2(splines,input,count);
+
+                default:
+                    break;
+            }
+
+#endif
+
+            return fire_generic(splines,input,0,count);
+        }
+
+        /*!
+            Add value of spline at column[s] to outputs[s] for s below count.
+        */
+        static void fire_column(const Quantized& spline,const number* column,size_t count,number* outputs)
+        {
+#if defined(SNN_SIMD_DISPATCH)
+
+            switch( simd_level() )
+            {
+                case SIMDLevel::AVX512:
+                    return fire_column_avx512(spline,column,count,outputs);
+
+                case SIMDLevel::AVX2:
+                    return fire_column_avx2(spline,column,count,outputs);
+
+                default:
+                    break;
+            }
+
+#endif
+
+            fire_column_generic(spline,column,0,count,outputs);
+        }
+
+    };
+
+}
@@ -13,6 +13,7 @@
 
 #include "initializers/uniform.hpp"
 #include "initializers/gauss.hpp"
+#include "rng.hpp"
 #include <ranges>
 
 namespace snn
@@ -463,8 +464,6 @@ namespace snn
         // used in fiting process to distribute error
         snn::SIMDVectorLite<InputSize> active_values;
 
-        snn::UniformInit<(number)0.f,(number)1.f> uniform_init;
-
         snn::SIMDVectorLite<InputSize> x_x;
 
         public:
@@ -474,17 +473,7 @@ namespace snn
 
             this->splines = new Spline[InputSize];
 
-            for(size_t i=0;i<InputSize;++i)
-            {
-                // if(this->uniform_init.init() < 0.25f)
-                {
-                   this->active_values[i] = this->uniform_init.init();
-                }
-                // else
-                // {
-                //     this->active_values[i] = 0.f;
-                // }
-            }
+            random_uniform(this->active_values);
 
             number prob_mean = this->active_values.reduce();
 
@@ -556,19 +545,15 @@ namespace snn
 
             output += this->x_x.reduce();
 
-            // generate fit select probablitiy for each node
+            // generate fit select probablitiy for each node, a quarter of them is active
 
-            for(size_t i=0;i<InputSize;++i)
-            {
-                if(this->uniform_init.init() < 0.25f)
-                {
-                   this->active_values[i] = this->uniform_init.init();
-                }
-                else
-                {   
-                    this->active_values[i] = 0.f;
-                }
-            }
+            snn::SIMDVectorLite<InputSize> active;
+
+            random_uniform(active);
+
+            random_uniform(this->active_values);
+
+            this->active_values *= active < 0.25f;
 
             number prob_mean = this->active_values.reduce();
 
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <bit>
 
 #include <simd_vector_lite.hpp>
 #include <misc.hpp>
+#include <half_number.hpp>
 
 #include <evo_kan_spline_node.hpp>
+#include <arena.hpp>
 #include <config.hpp>
 
 namespace snn
@@ -13,23 +17,44 @@ namespace snn
 
     /*!
         A class that represents spline curve used by EVO KAN as activations function.
+
+        Nodes are kept inside of object as two aligned arrays, one with x and one with y
+        coordinates, so an array of splines is one contiguous block of memory. It never
+        allocates, Arena is accepted only to share constructor with Spline.
+
+        Nodes are stored as Storage, e.g. half or bfloat16 from half_number.hpp, and
+        converted to number for every computation.
     */
-    template<size_t Size>
+    template<size_t Size,class Storage = SPLINE_STORAGE>
     class SplineStatic
     {
+        static_assert(Size > 1,"SplineStatic requires at least two nodes");
+
         protected:
 
-        std::array<SplineNode*,Size> nodes;
+        alignas(SPLINE_NODE_ALIGNMENT) Storage nodes_x[Size];
+
+        alignas(SPLINE_NODE_ALIGNMENT) Storage nodes_y[Size];
 
         void sort_nodes();
 
         public:
 
-        SplineStatic( size_t initial_size = 8 );
-        
+        // splines that can be trained
+        static constexpr bool read_only = false;
+
+        SplineStatic( size_t initial_size = 8 , Arena* arena = nullptr );
+
         void fit(number x,number y);
 
-        std::pair<SplineNode*,SplineNode*> search(number x);
+        void fit(number x,number y,std::pair<size_t,size_t> nodes);
+
+        void fit_batch(const number* x,const number* y,size_t count);
+
+        template<class Node>
+        static size_t lower_node(const Node* nodes_x,number x);
+
+        std::pair<size_t,size_t> search(number x) const;
 
         void remove_redudant_points();
 
@@ -39,7 +64,22 @@ namespace snn
 
         void simplify();
 
-        number fire(number x);
+        number fire(number x) const;
+
+        const Storage* get_x() const
+        {
+            return this->nodes_x;
+        }
+
+        const Storage* get_y() const
+        {
+            return this->nodes_y;
+        }
+
+        size_t length() const
+        {
+            return Size;
+        }
 
         void printInfo(std::ostream& out);
 
@@ -47,102 +87,104 @@ namespace snn
 
         void load(std::istream& out);
 
-        ~SplineStatic();
-
     };
 
 
     /*!
             In order for function to work, nodes has to be sorted in asceding order.
     */
-    template<size_t Size>
-    void SplineStatic<Size>::sort_nodes()
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::sort_nodes()
     {
-        std::sort(this->nodes.begin(),this->nodes.end(),[](SplineNode* a, SplineNode* b)
+        std::array<SplineNode,Size> nodes;
+
+        for(size_t i=0;i<Size;++i)
+        {
+            nodes[i] = SplineNode(this->nodes_x[i],this->nodes_y[i]);
+        }
+
+        std::sort(nodes.begin(),nodes.end(),[](const SplineNode& a,const SplineNode& b)
                 {
-                    return a->x < b->x;
+                    return a.x < b.x;
                 });
+
+        for(size_t i=0;i<Size;++i)
+        {
+            this->nodes_x[i] = nodes[i].x;
+            this->nodes_y[i] = nodes[i].y;
+        }
     }
 
-    template<size_t Size>
-    SplineStatic<Size>::SplineStatic( size_t initial_size )
+    template<size_t Size,class Storage>
+    SplineStatic<Size,Storage>::SplineStatic( size_t initial_size , Arena* arena )
     {
 
         number min_x = DEF_X_LEFT;
         number max_x = DEF_X_RIGHT;
 
-        const number step = ( max_x - min_x )/Size;
+        const number step = ( max_x - min_x )/(Size-1);
 
         DEF_Y_INIT init;
 
-        size_t i = 0;
-        
-        while( min_x <= max_x )
+        for(size_t i=0;i<Size;++i)
         {
-            number y = init.init();
+            this->nodes_x[i] = min_x + step*i;
 
-            SplineNode *node = new SplineNode(min_x,y);
-
-            this->nodes[i++] = node;
-
-            min_x += step;
+            this->nodes_y[i] = init.init();
         }
 
     }
-    
+
     /*!
 
         Update SplineStatic with new point.
-    
+
     */
-    template<size_t Size>
-    void SplineStatic<Size>::fit(number x,number y)
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::fit(number x,number y)
     {
-        // Check if point exists aleardy in SplineStatic
-        std::pair<SplineNode*,SplineNode*> nodes = this->search(x);
+        this->fit(x,y,this->search(x));
+    }
+
+    /*!
+        Update SplineStatic with new point, nodes is result of search for x.
+    */
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::fit(number x,number y,std::pair<size_t,size_t> nodes)
+    {
+        const bool has_left = nodes.first != SPLINE_NO_NODE;
+        const bool has_right = nodes.second != SPLINE_NO_NODE;
 
         // Check if points swarming is possible
-        if( nodes.first && nodes.second )
+        if( has_left && has_right )
         {
-            SplineNode* left = nodes.first;
-            SplineNode* right = nodes.second;
-
-            SIMDVectorLite<2> dx;
+            Storage& left_x = this->nodes_x[nodes.first];
+            Storage& left_y = this->nodes_y[nodes.first];
 
-            dx[0] = left->x;
-            dx[1] = right->x;
+            Storage& right_x = this->nodes_x[nodes.second];
+            Storage& right_y = this->nodes_y[nodes.second];
 
-            dx -= x;
+            number dx_left = static_cast<number>(left_x) - x;
+            number dx_right = static_cast<number>(right_x) - x;
 
-            dx*=dx;
+            dx_left *= dx_left;
+            dx_right *= dx_right;
 
             // if x is closer to left nudge left point
-            if(dx[0] < dx[1])
+            if(dx_left < dx_right)
             {
-                left->y -= 0.1f*( left->y - y );
-                
-                left->x -= 0.1f*( left->x - x );
+                left_y -= 0.1f*( static_cast<number>(left_y) - y );
 
-                // number a = ( right->y - y ) / ( right->x - x );
-
-                // number new_y = a*( left->x - x ) + y;
-
-                // left->y -= 0.1f*( left->y - new_y );
+                left_x -= 0.1f*( static_cast<number>(left_x) - x );
 
                 return;
             }
             // if x is closer to right nudge right point
-            else if(dx[1] < dx[0])
+            else if(dx_right < dx_left)
             {
-                right->y -= 0.1f*( right->y - y );
-
-                right->x -= 0.1f*( right->x - x );
+                right_y -= 0.1f*( static_cast<number>(right_y) - y );
 
-                // number a = ( left->y - y ) / ( left->x - x );
-
-                // number new_y = a*( right->x - x ) + y;
-
-                // right->y -= 0.1f*( right->y - new_y );
+                right_x -= 0.1f*( static_cast<number>(right_x) - x );
 
                 return;
             }
@@ -150,20 +192,20 @@ namespace snn
         }
 
         // if x is equal to one of the nodes x, nudge y
-        if( nodes.first && nodes.first->x == x )
+        if( has_left && this->nodes_x[nodes.first] == x )
         {
-            SplineNode* left = nodes.first;
+            Storage& left_y = this->nodes_y[nodes.first];
 
-            left->y -= 0.1f*( left->y - y );
+            left_y -= 0.1f*( static_cast<number>(left_y) - y );
 
             return;
         }
         // if x is equal to one of the nodes x, nudge y
-        if( nodes.second && nodes.second->x == x )
+        if( has_right && this->nodes_x[nodes.second] == x )
         {
-            SplineNode* right = nodes.second;
+            Storage& right_y = this->nodes_y[nodes.second];
 
-            right->y -= 0.1f*( right->y - y );
+            right_y -= 0.1f*( static_cast<number>(right_y) - y );
 
             return;
         }
@@ -171,135 +213,182 @@ namespace snn
     }
 
     /*!
-        It use binary search to find pair of points with x between them.
+        Update SplineStatic with count points at once. Points pick nodes like in fit,
+        against nodes from before the batch, and summed nudges are applied in one pass.
+        Points that doesn't nudge any node are ignored, as in fit.
     */
-    template<size_t Size>
-    std::pair<SplineNode*,SplineNode*> SplineStatic<Size>::search(number x)
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::fit_batch(const number* x,const number* y,size_t count)
     {
+        number target_x[Size] = {0};
+        number target_y[Size] = {0};
 
-        if( this->nodes.size() == 0 )
-        {
-            return std::pair<SplineNode*,SplineNode*>(nullptr,nullptr);
-        }
+        uint32_t hits_x[Size] = {0};
+        uint32_t hits_y[Size] = {0};
 
-        if( this->nodes.size() == 1 )
+        for(size_t s=0;s<count;++s)
         {
-            this->nodes[0]->index = 0;
+            std::pair<size_t,size_t> nodes = this->search(x[s]);
 
-            return std::pair<SplineNode*,SplineNode*>(this->nodes[0],this->nodes[0]);
-        }
+            const bool has_left = nodes.first != SPLINE_NO_NODE;
+            const bool has_right = nodes.second != SPLINE_NO_NODE;
 
-        if( x < this->nodes[0]->x )
-        {
-            this->nodes[0]->index = 0;
+            if( has_left && has_right )
+            {
+                number dx_left = static_cast<number>(this->nodes_x[nodes.first]) - x[s];
+                number dx_right = static_cast<number>(this->nodes_x[nodes.second]) - x[s];
 
-            return std::pair<SplineNode*,SplineNode*>(nullptr,this->nodes[0]);
-        }
-        
-        if( x > this->nodes[this->nodes.size()-1]->x )
-        {
-            this->nodes[this->nodes.size()-1]->index = this->nodes.size()-1;
+                dx_left *= dx_left;
+                dx_right *= dx_right;
 
-            return std::pair<SplineNode*,SplineNode*>(this->nodes[this->nodes.size()-1],nullptr);
-        }
+                if( dx_left != dx_right )
+                {
+                    const size_t id = dx_left < dx_right ? nodes.first : nodes.second;
 
+                    target_x[id] += x[s];
+                    target_y[id] += y[s];
 
-        size_t p = 0;
-        size_t q = this->nodes.size()-1;
+                    hits_x[id]++;
+                    hits_y[id]++;
 
-        size_t center = (p+q)/2;
-
-        while( (q-p) > 1 )
-        {
-            SplineNode* center_node = this->nodes[center];
+                    continue;
+                }
+            }
 
-            if( x > center_node->x )
+            if( has_left && this->nodes_x[nodes.first] == x[s] )
             {
-                p = center;
+                target_y[nodes.first] += y[s];
+
+                hits_y[nodes.first]++;
+
+                continue;
             }
-            else if( x < center_node->x )
+
+            if( has_right && this->nodes_x[nodes.second] == x[s] )
             {
-                q = center;
+                target_y[nodes.second] += y[s];
+
+                hits_y[nodes.second]++;
             }
-            else
+        }
+
+        for(size_t i=0;i<Size;++i)
+        {
+            if( hits_y[i] > 0 )
             {
-                center_node->index = center;
-                this->nodes[center+1]->index = center+1;
+                const number rate = nudge_rate(0.1f,hits_y[i]);
 
-                return std::pair<SplineNode*,SplineNode*>(center_node,this->nodes[center+1]);
+                this->nodes_y[i] -= rate*( static_cast<number>(this->nodes_y[i]) - target_y[i]/hits_y[i] );
             }
 
-            center = (p+q)/2;
+            if( hits_x[i] > 0 )
+            {
+                const number rate = nudge_rate(0.1f,hits_x[i]);
+
+                this->nodes_x[i] -= rate*( static_cast<number>(this->nodes_x[i]) - target_x[i]/hits_x[i] );
+            }
         }
+    }
+
+    /*!
+        Index of last node with x not bigger than given x, or 0 when there is none.
 
-        SplineNode* left = this->nodes[center];
-        left->index = p;
+        Search has fixed depth of log2(Size) steps known at compile time, each step
+        is a conditional move instead of a branch, so random inputs don't cause
+        branch mispredictions.
+    */
+    template<size_t Size,class Storage>
+    template<class Node>
+    size_t SplineStatic<Size,Storage>::lower_node(const Node* nodes_x,number x)
+    {
+        size_t p = 0;
 
-        SplineNode* right = this->nodes[center+1];
-        right->index = q;
+        for(size_t step=std::bit_floor(Size-1);step>0;step>>=1)
+        {
+            const size_t candidate = p + step;
 
-        return std::pair<SplineNode*,SplineNode*>(left,right);
+            p = ( candidate < Size && nodes_x[candidate] <= x ) ? candidate : p;
+        }
 
+        return p;
     }
 
-
     /*!
-        Activation function.
+        Find pair of nodes with x between them, it doesn't modify spline so it can be
+        called from many threads at once.
+
+        Returns indexes of left and right node, SPLINE_NO_NODE marks missing node.
     */
-    template<size_t Size>
-    number SplineStatic<Size>::fire(number x)
+    template<size_t Size,class Storage>
+    std::pair<size_t,size_t> SplineStatic<Size,Storage>::search(number x) const
     {
-        if( nodes.size() == 0 )
+        if( x < this->nodes_x[0] )
         {
-            return 0.f;
+            return std::pair<size_t,size_t>(SPLINE_NO_NODE,0);
         }
 
-        std::pair<SplineNode*,SplineNode*> nodes = this->search(x);
-
-        if( !nodes.first && !nodes.second )
+        if( x > this->nodes_x[Size-1] )
         {
-            return 0.f;
+            return std::pair<size_t,size_t>(Size-1,SPLINE_NO_NODE);
         }
 
-        if( nodes.first && !nodes.second )
+        const size_t p = std::min<size_t>(SplineStatic::lower_node(this->nodes_x,x),Size-2);
+
+        return std::pair<size_t,size_t>(p,p+1);
+
+    }
+
+
+    /*!
+        Activation function.
+    */
+    template<size_t Size,class Storage>
+    number SplineStatic<Size,Storage>::fire(number x) const
+    {
+        std::pair<size_t,size_t> nodes = this->search(x);
+
+        if( nodes.second == SPLINE_NO_NODE )
         {
-            return nodes.first->x == x ? nodes.first->y : 0;
+            return this->nodes_x[nodes.first] == x ? static_cast<number>(this->nodes_y[nodes.first]) : 0;
         }
 
-        if( !nodes.first && nodes.second )
+        if( nodes.first == SPLINE_NO_NODE )
         {
-            return nodes.second->x == x ? nodes.second->y : 0;
+            return this->nodes_x[nodes.second] == x ? static_cast<number>(this->nodes_y[nodes.second]) : 0;
         }
 
-        if( nodes.first->x == nodes.second->x )
+        const number left_x = this->nodes_x[nodes.first];
+        const number right_x = this->nodes_x[nodes.second];
+
+        const number left_y = this->nodes_y[nodes.first];
+        const number right_y = this->nodes_y[nodes.second];
+
+        if( left_x == right_x )
         {
-            return nodes.first->x == x ? nodes.first->y : 0; 
-        }   
+            return left_x == x ? left_y : 0;
+        }
 
         // let's use linear approximation
 
-        number _x = x - nodes.first->x;
+        number _x = x - left_x;
 
-        SplineNode* left = nodes.first;
-        SplineNode* right = nodes.second;
+        number a = ( right_y - left_y )/( right_x - left_x );
 
-        number a = ( right->y - left->y )/( right->x - left->x );
-
-        return a*_x + left->y;
+        return a*_x + left_y;
 
     }
 
 
-    template<size_t Size>
-    void SplineStatic<Size>::printInfo(std::ostream& out)
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::printInfo(std::ostream& out)
     {
-        out<<"Node count: "<<this->nodes.size()<<std::endl;
+        out<<"Node count: "<<Size<<std::endl;
     }
 
-    template<size_t Size>
-    void SplineStatic<Size>::save(std::ostream& out) const
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::save(std::ostream& out) const
     {
-        uint32_t len = this->nodes.size();
+        uint32_t len = Size;
 
         char len_buffer[4];
 
@@ -312,50 +401,46 @@ namespace snn
 
         char buffer[buffor_size];
 
-        for( SplineNode* node : this->nodes )
+        for(size_t i=0;i<Size;++i)
         {
-            node->serialize(buffer);
+            SplineNode(this->nodes_x[i],this->nodes_y[i]).serialize(buffer);
 
             out.write(buffer,buffor_size);
         }
     }
 
-    template<size_t Size>
-    void SplineStatic<Size>::load(std::istream& in)
+    template<size_t Size,class Storage>
+    void SplineStatic<Size,Storage>::load(std::istream& in)
     {
         char len_buffer[4];
 
         in.read(len_buffer,4);
 
-        uint32_t nodes_to_read;        
+        uint32_t nodes_to_read;
 
         memmove((char*)&nodes_to_read,len_buffer,4);
 
+        if( nodes_to_read != Size )
+        {
+            throw std::runtime_error("Spline node count mismatch in byte stream!!!");
+        }
+
         constexpr size_t buffor_size = SplineNode::size_for_serialization();
 
         char buffer[buffor_size];
 
+        SplineNode node;
+
         for(uint32_t i=0;i<nodes_to_read;++i)
         {
             in.read(buffer,buffor_size);
 
-            SplineNode* node = new SplineNode();
-
-            node->deserialize(buffer);
+            node.deserialize(buffer);
 
-            this->nodes.push_back(node);
-        }
-
-    }
-
-    template<size_t Size>
-    SplineStatic<Size>::~SplineStatic()
-    {
-        for( SplineNode* node : this->nodes )
-        {
-            delete node;
+            this->nodes_x[i] = node.x;
+            this->nodes_y[i] = node.y;
         }
 
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,439 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+
+#include <config.hpp>
+
+namespace snn
+{
+    /*!
+        A pool of long lived worker threads shared by all layers.
+
+        Each worker owns a deque of tasks, it takes tasks from the back of its own deque
+        and when it runs out of work it steals from the front of other workers deques.
+        Thread that waits in parallel() helps only with work of its own call, so
+        parallel() can be safely called from inside of a task, and a caller isn't
+        stalled by long tasks queued by other threads.
+    */
+    class ThreadPool
+    {
+        typedef std::function<void()> task_t;
+
+        struct Queue
+        {
+            std::deque<task_t> tasks;
+
+            std::mutex mux;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        std::vector<std::thread> workers;
+
+        // amount of tasks waiting in all queues
+        std::atomic<size_t> queued;
+
+        std::atomic<size_t> next_queue;
+
+        std::mutex sleep_mux;
+
+        std::condition_variable wake;
+
+        bool stopping;
+
+        /*!
+            State of a single parallel() call. Caller and pool threads claim indices
+            of this call from next, so a thread that waits for its own call never runs
+            tasks of other calls. Tasks pushed to queues may start after the call has
+            returned, so group is counted by refs and freed by whoever leaves it last.
+        */
+        class Group
+        {
+            void (*call)(void*,size_t);
+
+            void* func;
+
+            const size_t task_count;
+
+            std::atomic<size_t> next;
+
+            std::atomic<size_t> remaining;
+
+            std::atomic<size_t> refs;
+
+            std::atomic<bool> failed;
+
+            bool finished;
+
+            std::mutex mux;
+
+            std::condition_variable done;
+
+            public:
+
+            std::exception_ptr error;
+
+            template<class Func>
+            Group(Func& func,size_t task_count,size_t refs)
+            : call([](void* func,size_t i){ (*static_cast<Func*>(func))(i); }),
+            func(const_cast<void*>(static_cast<const void*>(&func))),
+            task_count(task_count),
+            next(0),
+            remaining(task_count),
+            refs(refs),
+            failed(false),
+            finished(task_count == 0)
+            {}
+
+            /*!
+                Run indices of this call until none is left to claim.
+            */
+            void help()
+            {
+                size_t i;
+
+                while( ( i = this->next.fetch_add(1,std::memory_order_relaxed) ) < this->task_count )
+                {
+                    if( !this->failed.load(std::memory_order_relaxed) )
+                    {
+                        try
+                        {
+                            this->call(this->func,i);
+                        }
+                        catch(...)
+                        {
+                            std::lock_guard guard(this->mux);
+
+                            if( !this->error )
+                            {
+                                this->error = std::current_exception();
+                            }
+
+                            this->failed.store(true,std::memory_order_relaxed);
+                        }
+                    }
+
+                    if( this->remaining.fetch_sub(1,std::memory_order_acq_rel) == 1 )
+                    {
+                        std::lock_guard guard(this->mux);
+
+                        this->finished = true;
+
+                        this->done.notify_all();
+                    }
+                }
+            }
+
+            bool busy() const
+            {
+                return this->remaining.load(std::memory_order_acquire) > 0;
+            }
+
+            void wait()
+            {
+                std::unique_lock lock(this->mux);
+
+                this->done.wait(lock,[this]{
+                    return this->finished;
+                });
+            }
+
+            void release()
+            {
+                if( this->refs.fetch_sub(1,std::memory_order_acq_rel) == 1 )
+                {
+                    delete this;
+                }
+            }
+        };
+
+        // id of a queue owned by current thread, -1 for threads outside of pool
+        static inline thread_local size_t worker_id = static_cast<size_t>(-1);
+
+        static inline thread_local const ThreadPool* worker_pool = nullptr;
+
+        void push(task_t&& task)
+        {
+            size_t id;
+
+            if( worker_pool == this )
+            {
+                id = worker_id;
+            }
+            else
+            {
+                id = this->next_queue.fetch_add(1,std::memory_order_relaxed) % this->queues.size();
+            }
+
+            Queue& queue = *this->queues[id];
+
+            {
+                std::lock_guard guard(queue.mux);
+
+                queue.tasks.push_back(std::move(task));
+            }
+
+            this->queued.fetch_add(1,std::memory_order_release);
+        }
+
+        /*!
+            Take a task from own queue back, or steal it from other queue front.
+        */
+        bool take(task_t& task)
+        {
+            const size_t count = this->queues.size();
+
+            size_t start = 0;
+
+            if( worker_pool == this )
+            {
+                start = worker_id;
+
+                Queue& own = *this->queues[start];
+
+                std::lock_guard guard(own.mux);
+
+                if( !own.tasks.empty() )
+                {
+                    task = std::move(own.tasks.back());
+
+                    own.tasks.pop_back();
+
+                    this->queued.fetch_sub(1,std::memory_order_relaxed);
+
+                    return true;
+                }
+            }
+
+            for(size_t i=0;i<count;++i)
+            {
+                Queue& victim = *this->queues[(start+i)%count];
+
+                std::lock_guard guard(victim.mux);
+
+                if( !victim.tasks.empty() )
+                {
+                    task = std::move(victim.tasks.front());
+
+                    victim.tasks.pop_front();
+
+                    this->queued.fetch_sub(1,std::memory_order_relaxed);
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void worker_loop(size_t id)
+        {
+            worker_id = id;
+            worker_pool = this;
+
+            task_t task;
+
+            while( true )
+            {
+                if( this->take(task) )
+                {
+                    task();
+
+                    task = nullptr;
+
+                    continue;
+                }
+
+                std::unique_lock lock(this->sleep_mux);
+
+                this->wake.wait(lock,[this]{
+                    return this->stopping || this->queued.load(std::memory_order_acquire) > 0;
+                });
+
+                if( this->stopping )
+                {
+                    return;
+                }
+            }
+        }
+
+        void start(size_t thread_count)
+        {
+            if( thread_count == 0 )
+            {
+                thread_count = 1;
+            }
+
+            this->stopping = false;
+
+            for(size_t i=0;i<thread_count;++i)
+            {
+                this->queues.push_back(std::make_unique<Queue>());
+            }
+
+            for(size_t i=0;i<thread_count;++i)
+            {
+                this->workers.push_back(std::thread(&ThreadPool::worker_loop,this,i));
+            }
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard guard(this->sleep_mux);
+
+                this->stopping = true;
+            }
+
+            this->wake.notify_all();
+
+            for(std::thread& worker : this->workers)
+            {
+                worker.join();
+            }
+
+            this->workers.clear();
+
+            // helpers still queued hold refs of their groups, run them so groups are freed
+            task_t task;
+
+            while( this->take(task) )
+            {
+                task();
+
+                task = nullptr;
+            }
+
+            this->queues.clear();
+        }
+
+        public:
+
+        /*!
+            Caller of parallel() runs tasks too, so by default pool has one worker less
+            than hardware threads.
+        */
+        static size_t default_size()
+        {
+            return std::max<size_t>(std::thread::hardware_concurrency(),2) - 1;
+        }
+
+        ThreadPool( size_t thread_count = default_size() )
+        : queued(0),
+        next_queue(0)
+        {
+            this->start(thread_count);
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /*!
+            A pool used by layers, with default_size() workers.
+        */
+        static ThreadPool& global()
+        {
+            static ThreadPool pool;
+
+            return pool;
+        }
+
+        size_t size() const
+        {
+            return this->workers.size();
+        }
+
+        /*!
+            Threads that run tasks of one parallel() call, workers and the caller.
+        */
+        size_t concurrency() const
+        {
+            return this->workers.size() + 1;
+        }
+
+        /*!
+            Change amount of worker threads, it cannot be called while pool is in use.
+        */
+        void resize(size_t thread_count)
+        {
+            this->stop();
+
+            this->start(thread_count);
+        }
+
+        /*!
+            Run func(i) for i from 0 to task_count-1 on caller and pool threads and wait
+            for all of them to finish. While it waits, caller runs only indices of this
+            call, so it is never held up by tasks of other callers. If any func throws,
+            indices that didn't start yet are skipped and the first exception is rethrown
+            once every started one has returned.
+        */
+        template<class Func>
+        void parallel(size_t task_count,Func&& func)
+        {
+            // caller runs indices too, so it needs one helper less
+            const size_t helpers = std::min(task_count,this->queues.size()+1) - ( task_count > 0 );
+
+            Group* group = new Group(func,task_count,helpers+1);
+
+            for(size_t i=0;i<helpers;++i)
+            {
+                this->push([group]{
+
+                    group->help();
+
+                    group->release();
+                });
+            }
+
+            if( helpers > 0 )
+            {
+                {
+                    std::lock_guard guard(this->sleep_mux);
+                }
+
+                // one worker per helper, the rest keeps sleeping
+                for(size_t i=0;i<helpers;++i)
+                {
+                    this->wake.notify_one();
+                }
+            }
+
+            group->help();
+
+            // rest of indices is already running on pool threads
+            for(size_t spins=0; group->busy() && spins < THREAD_POOL_WAIT_SPINS; ++spins)
+            {
+                std::this_thread::yield();
+            }
+
+            group->wait();
+
+            std::exception_ptr error = group->error;
+
+            group->release();
+
+            if( error )
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        ~ThreadPool()
+        {
+            this->stop();
+        }
+
+    };
+
+}
@@ -56,16 +56,9 @@
 
 size_t get_action_id(const snn::SIMDVector& actions)
 {
-    std::random_device rd; 
-
-    // Mersenne twister PRNG, initialized with seed from previous random device instance
-    std::mt19937 gen(rd()); 
-
-    std::uniform_real_distribution<number> uniform_chooser(0.f,1.f);
-
     number shift = 0;
 
-    number choose = uniform_chooser(gen);
+    number choose = snn::random_uniform();
 
     size_t action_id = 0;
 
@@ -469,8 +462,6 @@ int main(int argc,char** argv)
 
     snn::UniformInit<(number)-0.5f,(number)0.5f> noise;
 
-    snn::UniformInit<(number)0.f,(number)1.f> chooser;
-
     const size_t dataset_size = 32;
 
     snn::SIMDVectorLite<4096> dataset[dataset_size];
@@ -514,7 +505,7 @@ int main(int argc,char** argv)
             // }
 
             start = std::chrono::system_clock::now();
-            kan.fit(dataset[i],outputs[i]);
+            kan.fire_and_fit(dataset[i],outputs[i]);
 
             // kan2.fit(mid_output,outputs[i]);
         
@@ -528,23 +519,19 @@ int main(int argc,char** argv)
 
     number error = 0.f;
 
-    for(size_t i=0;i<dataset_size;++i)
-    {
-        snn::SIMDVectorLite<64> output;
-
-        snn::SIMDVectorLite<64> y = outputs[i];
-
-        start = std::chrono::system_clock::now();
+    snn::SIMDVectorLite<64> fired[dataset_size];
 
-        // auto mid_output = kan.fire(dataset[i]);
+    start = std::chrono::system_clock::now();
 
-        output = kan.fire(dataset[i]);
+    kan.fire(dataset,dataset_size,fired);
 
-        end = std::chrono::system_clock::now();
+    end = std::chrono::system_clock::now();
 
-        std::cout<<"Time: "<<std::chrono::duration<double>(end - start)<<" s"<<std::endl;
+    std::cout<<"Batch time: "<<std::chrono::duration<double>(end - start)<<" s, per sample: "<<std::chrono::duration<double>(end - start)/dataset_size<<" s"<<std::endl;
 
-        error += abs( (y - output).reduce() );
+    for(size_t i=0;i<dataset_size;++i)
+    {
+        error += abs( (outputs[i] - fired[i]).reduce() );
     }
 
     std::cout<<"Error: "<<error/dataset_size<<std::endl;
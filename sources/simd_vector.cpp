@@ -1,3 +1,5 @@
+#include <limits>
+
 #include "simd_vector.hpp"
 
 namespace snn
@@ -715,6 +717,25 @@ namespace snn
         return output;
     }
 
+    number SIMDVector::max() const
+    {
+        if( this->vec.empty() )
+        {
+            return std::numeric_limits<number>::lowest();
+        }
+
+        SIMD output = this->vec.back();
+
+        where(this->get_partially_filled_simd(this->ptr,0.f,1.f) > 0.f,output) = std::numeric_limits<number>::lowest();
+
+        for(size_t i=0;i<this->vec.size()-1;++i)
+        {
+            output = std::experimental::max(output,this->vec[i]);
+        }
+
+        return std::experimental::hmax(output);
+    }
+
     number SIMDVector::length() const
     {
         number output=0;
@@ -0,0 +1,2177 @@
+/*
+    Tests and benchmarks of library, built as separate target so main stays
+    the training loop. Tests assert, benchmarks only print timings and run
+    when "bench" is passed as first argument.
+*/
+#include <experimental/simd>
+#include <iostream>
+#include <string_view>
+#include <cmath>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/wait.h>
+
+
+#include "config.hpp"
+
+#include "simd_vector.hpp"
+
+#include "layer_kac.hpp"
+ 
+#include "initializers/gauss.hpp"
+#include "initializers/constant.hpp"
+#include "initializers/uniform.hpp"
+#include "initializers/hu.hpp"
+
+#include "activation/sigmoid.hpp"
+#include "activation/relu.hpp"
+#include "activation/softmax.hpp"
+#include "activation/silu.hpp"
+
+
+#include "simd_vector_lite.hpp"
+
+#include "layer_counter.hpp"
+
+#include "arbiter.hpp"
+
+#include "evo_kan_layer_online.hpp"
+
+#include "evo_kan_layer_shared.hpp"
+
+#include "evo_kan_block.hpp"
+
+#include "evo_kan_layer.hpp"
+
+#include "block_kac.hpp"
+
+size_t snn::BlockCounter::BlockID = 0;
+
+size_t snn::LayerCounter::LayerIDCounter = 0;
+
+size_t resident_memory_kb()
+{
+    std::ifstream statm("/proc/self/statm");
+
+    size_t pages = 0;
+    size_t resident = 0;
+
+    statm>>pages>>resident;
+
+    return resident*(sysconf(_SC_PAGESIZE)/1024);
+}
+
+/*
+    Spline laid out like before node arrays and arenas, a vector of pointers with every
+    node allocated on its own. Kept only as baseline of bench_layer_allocation.
+*/
+struct LegacySpline
+{
+    std::vector<snn::SplineNode*> nodes;
+
+    void init(size_t initial_size)
+    {
+        this->nodes.reserve(initial_size);
+
+        number min_x = DEF_X_LEFT;
+        number max_x = DEF_X_RIGHT;
+
+        const number step = ( max_x - min_x )/initial_size;
+
+        DEF_Y_INIT init;
+
+        while( min_x <= max_x )
+        {
+            this->nodes.push_back(new snn::SplineNode(min_x,init.init()));
+
+            min_x += step;
+        }
+    }
+
+    ~LegacySpline()
+    {
+        for( snn::SplineNode* node : this->nodes )
+        {
+            delete node;
+        }
+    }
+};
+
+/*
+    Block laid out like EvoKan before arenas, splines in their own heap array.
+*/
+template<size_t inputSize>
+struct LegacyBlock
+{
+    LegacySpline* splines;
+
+    LegacyBlock(size_t initial_size)
+    {
+        this->splines = new LegacySpline[inputSize];
+
+        for(size_t i=0;i<inputSize;++i)
+        {
+            this->splines[i].init(initial_size);
+        }
+    }
+
+    ~LegacyBlock()
+    {
+        delete [] this->splines;
+    }
+};
+
+/*
+    Run func in a forked child, so memory freed by earlier benchmarks can't be reused
+    and RSS growth counts only pages touched by func.
+*/
+template<class Func>
+void run_in_fresh_process(Func&& func)
+{
+    std::cout.flush();
+
+    const pid_t pid = fork();
+
+    if( pid == 0 )
+    {
+        malloc_trim(0);
+
+        func();
+
+        std::cout.flush();
+
+        // static destructors would join pool threads, which don't exist in child
+        _exit(0);
+    }
+
+    int status = 0;
+
+    waitpid(pid,&status,0);
+}
+
+/*
+    Construct and destroy blocks of a layer, each in its own process, and report time
+    and RSS growth.
+*/
+template<class Construct>
+void bench_allocation_case(const char* name,Construct&& construct)
+{
+    run_in_fresh_process([&]{
+
+        const size_t rss_before = resident_memory_kb();
+
+        auto start = std::chrono::system_clock::now();
+
+        auto destroy = construct();
+
+        auto end = std::chrono::system_clock::now();
+
+        const size_t rss = resident_memory_kb() - rss_before;
+
+        std::cout<<name<<" construct time: "<<std::chrono::duration<double>(end - start)<<" RSS: "<<rss<<" kB"<<std::endl;
+
+        start = std::chrono::system_clock::now();
+
+        destroy();
+
+        end = std::chrono::system_clock::now();
+
+        std::cout<<name<<" destroy time: "<<std::chrono::duration<double>(end - start)<<std::endl;
+
+    });
+}
+
+/*
+    Compare EvoKanLayer that keeps everything in its arena with blocks allocated one by
+    one on the heap, both with node arrays and with the old node per allocation layout.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_layer_allocation(size_t spline_size)
+{
+    bench_allocation_case("Arena",[&]{
+
+        auto* layer = new snn::EvoKanLayer<inputSize,outputSize,SplineClass>(spline_size);
+
+        return [layer]{ delete layer; };
+    });
+
+    bench_allocation_case("Heap node arrays",[&]{
+
+        auto** blocks = new snn::EvoKan<inputSize,SplineClass>*[outputSize];
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            blocks[i] = new snn::EvoKan<inputSize,SplineClass>(spline_size);
+        }
+
+        return [blocks]{
+
+            for(size_t i=0;i<outputSize;++i)
+            {
+                delete blocks[i];
+            }
+
+            delete [] blocks;
+        };
+    });
+
+    bench_allocation_case("Heap node per allocation",[&]{
+
+        auto** blocks = new LegacyBlock<inputSize>*[outputSize];
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            blocks[i] = new LegacyBlock<inputSize>(spline_size);
+        }
+
+        return [blocks]{
+
+            for(size_t i=0;i<outputSize;++i)
+            {
+                delete blocks[i];
+            }
+
+            delete [] blocks;
+        };
+    });
+}
+
+/*
+    Measure fire time of layer with pool sizes from one thread to one per hardware thread.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_layer_scaling(snn::EvoKanLayer<inputSize,outputSize,SplineClass>& layer,const snn::SIMDVectorLite<inputSize>& input)
+{
+    std::chrono::time_point<std::chrono::system_clock> start, end;
+
+    snn::ThreadPool& pool = snn::ThreadPool::global();
+
+    const size_t max_workers = snn::ThreadPool::default_size();
+
+    const size_t repeats = 10;
+
+    for(size_t workers=1;workers<=max_workers;++workers)
+    {
+        pool.resize(workers);
+
+        layer.fire(input);
+
+        start = std::chrono::system_clock::now();
+
+        for(size_t i=0;i<repeats;++i)
+        {
+            layer.fire(input);
+        }
+
+        end = std::chrono::system_clock::now();
+
+        std::cout<<"Threads: "<<pool.concurrency()<<" fire time: "<<std::chrono::duration<double>(end - start)/repeats<<std::endl;
+    }
+
+    pool.resize(max_workers);
+}
+
+/*
+    Train two fresh layers on the same random data, one sample by sample and one
+    with fit_batch, and compare time and final error.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_fit_batch(size_t epochs)
+{
+    const size_t batch_size = 32;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> inputs(batch_size);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> targets(batch_size);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> outputs(batch_size);
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            inputs[s][i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            targets[s][i] = uniform.init();
+        }
+    }
+
+    for(size_t batched=0;batched<2;++batched)
+    {
+        snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer;
+
+        auto start = std::chrono::system_clock::now();
+
+        for(size_t e=0;e<epochs;++e)
+        {
+            if( batched )
+            {
+                layer.fit_batch(inputs.data(),targets.data(),batch_size);
+
+                continue;
+            }
+
+            for(size_t s=0;s<batch_size;++s)
+            {
+                layer.fire_and_fit(inputs[s],targets[s]);
+            }
+        }
+
+        auto end = std::chrono::system_clock::now();
+
+        layer.fire(inputs.data(),batch_size,outputs.data());
+
+        number error = 0.f;
+
+        // squared per output, so errors of opposite sign don't cancel
+        for(size_t s=0;s<batch_size;++s)
+        {
+            const snn::SIMDVectorLite<outputSize> diff = targets[s] - outputs[s];
+
+            error += ( diff*diff ).reduce();
+        }
+
+        std::cout<<( batched ? "Batched" : "Sequential" )<<" fit time: "<<std::chrono::duration<double>(end - start)<<" mean squared error: "<<error/(batch_size*outputSize)<<std::endl;
+    }
+}
+
+/*
+    Train layer with shared knots next to EvoKanLayer with SplineStatic that starts
+    from the same parameters, and compare thier outputs and fire latency.
+*/
+template<size_t inputSize,size_t outputSize,size_t Knots>
+void bench_shared_layer(size_t epochs)
+{
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    snn::SIMDVectorLite<inputSize> input;
+
+    snn::SIMDVectorLite<outputSize> target;
+
+    snn::EvoKanLayerShared<inputSize,outputSize,Knots> shared;
+
+    snn::EvoKanLayer<inputSize,outputSize,snn::SplineStatic<Knots>> layer;
+
+    std::stringstream stream;
+
+    shared.save(stream);
+
+    layer.load(stream);
+
+    number max_error = 0.f;
+
+    std::chrono::duration<double> shared_time(0);
+
+    std::chrono::duration<double> layer_time(0);
+
+    for(size_t e=0;e<epochs;++e)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            input[i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            target[i] = uniform.init();
+        }
+
+        auto start = std::chrono::system_clock::now();
+
+        snn::SIMDVectorLite<outputSize> shared_output = shared.fire(input);
+
+        auto end = std::chrono::system_clock::now();
+
+        shared_time += end - start;
+
+        start = std::chrono::system_clock::now();
+
+        snn::SIMDVectorLite<outputSize> layer_output = layer.fire(input);
+
+        end = std::chrono::system_clock::now();
+
+        layer_time += end - start;
+
+        snn::SIMDVectorLite<outputSize> diff = shared_output - layer_output;
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            max_error = std::max<number>(max_error,abs(diff[i]));
+        }
+
+        shared.fit(input,shared_output,target);
+
+        layer.fit(input,layer_output,target);
+    }
+
+    std::cout<<"Shared knots fire: "<<shared_time/epochs<<" block fire: "<<layer_time/epochs<<" max difference: "<<max_error<<std::endl;
+}
+
+/*
+    Train layer of SplineStatic or BasicSpline with nodes kept in given storage type,
+    and report its fire latency and error, to compare float with 16 bit storage types.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_spline_storage(size_t epochs)
+{
+    const size_t batch_size = 32;
+
+    const size_t repeats = 4;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> inputs(batch_size);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> targets(batch_size);
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            inputs[s][i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            targets[s][i] = uniform.init();
+        }
+    }
+
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer;
+
+    for(size_t e=0;e<epochs;++e)
+    {
+        layer.fit_batch(inputs.data(),targets.data(),batch_size);
+    }
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        for(size_t s=0;s<batch_size;++s)
+        {
+            layer.fire(inputs[s]);
+        }
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    number error = 0.f;
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        snn::SIMDVectorLite<outputSize> diff = layer.fire(inputs[s]) - targets[s];
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            error += abs(diff[i]);
+        }
+    }
+
+    std::cout<<"Node size: "<<sizeof(*std::declval<const SplineClass&>().get_x())<<" bytes, fire time: "<<std::chrono::duration<double>(end - start)/(repeats*batch_size)<<" mean error: "<<error/(batch_size*outputSize)<<std::endl;
+}
+
+/*
+    Compare vector arithmetic evaluated as one fused expression with the same
+    arithmetic done step by step through temporary vectors.
+*/
+template<size_t Size>
+void bench_vector_expression(size_t repeats)
+{
+    snn::UniformInit<(number)-1.f,(number)1.f> uniform;
+
+    snn::SIMDVectorLite<Size> a;
+    snn::SIMDVectorLite<Size> x;
+    snn::SIMDVectorLite<Size> y;
+
+    for(size_t i=0;i<Size;++i)
+    {
+        a[i] = uniform.init();
+        x[i] = uniform.init();
+        y[i] = uniform.init();
+    }
+
+    snn::SIMDVectorLite<Size> fused;
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        fused = a*(x*x) + y*0.5f;
+
+        x += fused*1e-6f;
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    auto fused_time = std::chrono::duration<double>(end - start)/repeats;
+
+    snn::SIMDVectorLite<Size> staged;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        snn::SIMDVectorLite<Size> square = x*x;
+
+        snn::SIMDVectorLite<Size> scaled = a*square;
+
+        snn::SIMDVectorLite<Size> half = y*0.5f;
+
+        staged = scaled + half;
+
+        snn::SIMDVectorLite<Size> step = staged*1e-6f;
+
+        x += step;
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto staged_time = std::chrono::duration<double>(end - start)/repeats;
+
+    std::cout<<"Size: "<<Size<<" fused: "<<fused_time<<" with temporaries: "<<staged_time<<" sum: "<<( fused + staged ).reduce()<<std::endl;
+}
+
+/*
+    Cost of copying and moving vectors, big ones keep blocks on heap and move
+    only their pointer.
+*/
+template<size_t Size>
+void bench_vector_storage(size_t repeats)
+{
+    std::vector<snn::SIMDVectorLite<Size>> vectors(repeats,snn::SIMDVectorLite<Size>(1.f));
+
+    std::vector<snn::SIMDVectorLite<Size>> copies(repeats);
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        copies[r] = vectors[r];
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    auto copy_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        copies[r] = std::move(vectors[r]);
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto move_time = std::chrono::duration<double>(end - start)/repeats;
+
+    std::cout<<"Size: "<<Size<<" object size: "<<sizeof(snn::SIMDVectorLite<Size>)<<" bytes, copy: "<<copy_time<<" move: "<<move_time<<" sum: "<<copies[0].reduce()<<std::endl;
+}
+
+/*
+    Run spline kernels, reduce and dot with every instruction set CPU supports and
+    report which one was chosen at startup.
+*/
+template<size_t inputSize,size_t outputSize>
+void bench_simd_dispatch(size_t repeats)
+{
+    const snn::SIMDLevel detected = snn::detect_simd_level();
+
+    std::cout<<"Detected SIMD level: "<<snn::simd_level_name(detected)<<", chosen: "<<snn::simd_level_name(snn::simd_level())<<std::endl;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    snn::SIMDVectorLite<inputSize> input;
+    snn::SIMDVectorLite<inputSize> weights;
+
+    for(size_t i=0;i<inputSize;++i)
+    {
+        input[i] = uniform.init();
+        weights[i] = uniform.init();
+    }
+
+    snn::EvoKanLayer<inputSize,outputSize,snn::SplineStatic<32>> layer;
+
+    layer.fit(input,snn::SIMDVectorLite<outputSize>(1.f));
+
+    snn::SIMDVectorLite<outputSize> reference = layer.fire(input);
+
+    for(snn::SIMDLevel level : {snn::SIMDLevel::Generic,snn::SIMDLevel::AVX2,snn::SIMDLevel::AVX512})
+    {
+        if( level > detected )
+        {
+            continue;
+        }
+
+        snn::set_simd_level(level);
+
+        auto start = std::chrono::system_clock::now();
+
+        number error = 0.f;
+
+        for(size_t r=0;r<repeats;++r)
+        {
+            snn::SIMDVectorLite<outputSize> diff = layer.fire(input) - reference;
+
+            for(size_t i=0;i<outputSize;++i)
+            {
+                error = std::max<number>(error,abs(diff[i]));
+            }
+        }
+
+        auto end = std::chrono::system_clock::now();
+
+        auto fire_time = std::chrono::duration<double>(end - start)/repeats;
+
+        number sum = 0.f;
+
+        start = std::chrono::system_clock::now();
+
+        for(size_t r=0;r<repeats*100;++r)
+        {
+            sum += input.dot(weights) + input.reduce();
+        }
+
+        end = std::chrono::system_clock::now();
+
+        auto dot_time = std::chrono::duration<double>(end - start)/(repeats*100);
+
+        std::cout<<snn::simd_level_name(level)<<" fire: "<<fire_time<<" dot and reduce: "<<dot_time<<" difference: "<<error<<" sum: "<<sum<<std::endl;
+    }
+
+    snn::set_simd_level(detected);
+}
+
+// distance between float and correctly rounded reference in units in the last place
+int64_t ulp_distance(number value,double reference)
+{
+    auto ordered = [](float f)
+    {
+        int32_t bits;
+
+        memcpy(&bits,&f,sizeof(bits));
+
+        return bits < 0 ? -static_cast<int64_t>(bits & 0x7FFFFFFF) : static_cast<int64_t>(bits);
+    };
+
+    return std::llabs(ordered(value) - ordered(static_cast<float>(reference)));
+}
+
+/*
+    Compare vectorized exp, log, tanh, sigmoid and SiLU with libm in double
+    precision, on Size points spread over each range, and check the error bounds
+    documented in simd_math.hpp.
+*/
+template<size_t Size>
+void test_simd_math()
+{
+    snn::SIMDVectorLite<Size> linear;
+    snn::SIMDVectorLite<Size> positive;
+
+    for(size_t i=0;i<Size;++i)
+    {
+        const double t = static_cast<double>(i)/( Size - 1 );
+
+        linear[i] = -87.f + 175.f*t;
+
+        positive[i] = 1e-30*std::pow(1e60,t);
+    }
+
+    auto check = [](const char* name,const snn::SIMDVectorLite<Size>& input,const snn::SIMDVectorLite<Size>& output,auto reference,number low,int64_t bound)
+    {
+        int64_t worst = 0;
+
+        for(size_t i=0;i<Size;++i)
+        {
+            if( input[i] >= low )
+            {
+                worst = std::max(worst,ulp_distance(output[i],reference(static_cast<double>(input[i]))));
+            }
+        }
+
+        std::cout<<name<<" max error: "<<worst<<" ULP"<<std::endl;
+
+        assert( worst <= bound );
+    };
+
+    check("exp",linear,snn::exp(linear),[](double x){ return std::exp(x); },-87.f,2);
+
+    check("log",positive,snn::log(positive),[](double x){ return std::log(x); },0.f,2);
+
+    check("tanh",linear,snn::tanh(linear),[](double x){ return std::tanh(x); },-87.f,2);
+
+    check("sigmoid",linear,snn::sigmoid(linear),[](double x){ return 1.0/( 1.0 + std::exp(-x) ); },-87.f,4);
+
+    check("silu",linear,snn::silu(linear),[](double x){ return x/( 1.0 + std::exp(-x) ); },-87.f,4);
+
+    // padding of SIMDVector has to stay zero, even where kernel gives non zero at 0
+    snn::SIMDVector vec(0.f,19);
+
+    assert( std::abs(snn::sigmoid(vec).reduce() - 0.5f*vec.size()) < 1e-5f );
+
+    assert( std::abs(snn::exp(vec).reduce() - vec.size()) < 1e-5f );
+}
+
+/*
+    Throughput of polynomial kernels against per lane libm calls.
+*/
+template<size_t Size>
+void bench_simd_math(size_t repeats)
+{
+    snn::UniformInit<(number)-10.f,(number)10.f> uniform;
+
+    snn::SIMDVectorLite<Size> x;
+
+    for(size_t i=0;i<Size;++i)
+    {
+        x[i] = uniform.init();
+    }
+
+    auto measure = [&](const char* name,auto function)
+    {
+        // first call pays for page faults of output buffer
+        number sum = function(x)[0];
+
+        auto start = std::chrono::system_clock::now();
+
+        for(size_t r=0;r<repeats;++r)
+        {
+            sum += function(x)[r%Size];
+        }
+
+        auto end = std::chrono::system_clock::now();
+
+        std::cout<<name<<": "<<std::chrono::duration<double>(end - start)/repeats<<" ";
+
+        return sum;
+    };
+
+    number sum = 0.f;
+
+    sum += measure("exp",[](const auto& v){ return snn::exp(v); });
+
+    sum += measure("libm simd exp",[](const auto& v){ return v.map([](const auto& block){ return std::experimental::exp(block); }); });
+
+    sum += measure("scalar std::exp",[](const auto& v)
+    {
+        snn::SIMDVectorLite<Size> output;
+
+        for(size_t i=0;i<Size;++i)
+        {
+            output[i] = std::exp(v[i]);
+        }
+
+        return output;
+    });
+
+    sum += measure("log",[](const auto& v){ return snn::log(snn::SIMDVectorLite<Size>(v + 11.f)); });
+
+    sum += measure("tanh",[](const auto& v){ return snn::tanh(v); });
+
+    sum += measure("sigmoid",[](const auto& v){ return snn::sigmoid(v); });
+
+    sum += measure("silu",[](const auto& v){ return snn::silu(v); });
+
+    std::cout<<"Size: "<<Size<<" sum: "<<sum<<std::endl;
+}
+
+/*
+    Softmax must sum to one for any logits, log_softmax must match log of it and
+    sampling has to follow the distribution.
+*/
+template<size_t Size>
+void test_softmax()
+{
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    snn::SIMDVectorLite<Size> logits;
+
+    snn::SIMDVector vec_logits;
+
+    for(size_t i=0;i<Size;++i)
+    {
+        const number logit = uniform.init();
+
+        logits[i] = logit;
+
+        vec_logits.append(logit);
+    }
+
+    // shift that overflows exp without subtracting max
+    for(number shift : {0.f,1000.f,-1000.f})
+    {
+        snn::SIMDVectorLite<Size> shifted = logits + shift;
+
+        snn::SIMDVectorLite<Size> probabilities = snn::softmax(shifted);
+
+        snn::SIMDVectorLite<Size> log_probabilities = snn::log_softmax(shifted);
+
+        snn::SIMDVector vec_probabilities = snn::softmax(vec_logits + shift);
+
+        assert( std::abs(probabilities.reduce() - 1.f) < 1e-5f );
+
+        assert( std::abs(vec_probabilities.reduce() - 1.f) < 1e-5f );
+
+        for(size_t i=0;i<Size;++i)
+        {
+            assert( std::abs(std::log(probabilities[i]) - log_probabilities[i]) < 1e-4f );
+
+            assert( std::abs(probabilities[i] - vec_probabilities[i]) < 1e-6f );
+        }
+    }
+
+    snn::SIMDVectorLite<Size> probabilities = snn::softmax(logits);
+
+    std::vector<size_t> counts(Size,0);
+
+    const size_t draws = 100000;
+
+    for(size_t i=0;i<draws;++i)
+    {
+        counts[snn::sample_softmax(logits,( i + 0.5f )/draws)]++;
+    }
+
+    for(size_t i=0;i<Size;++i)
+    {
+        assert( std::abs(static_cast<number>(counts[i])/draws - probabilities[i]) < 1e-3f );
+    }
+}
+
+/*
+    Softmax output head of KapiBara_SubLayer, softmax and sampling against
+    get_action_id on softmax output.
+*/
+template<size_t Size>
+void bench_softmax(size_t repeats)
+{
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    snn::SIMDVectorLite<Size> logits;
+
+    for(size_t i=0;i<Size;++i)
+    {
+        logits[i] = uniform.init();
+    }
+
+    number sum = 0.f;
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        sum += snn::softmax(logits)[r%Size];
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    auto softmax_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        sum += snn::log_softmax(logits)[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto log_softmax_time = std::chrono::duration<double>(end - start)/repeats;
+
+    size_t actions = 0;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        actions += snn::sample_softmax(logits);
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto sample_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        actions += snn::get_action_id(snn::softmax(logits));
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto action_time = std::chrono::duration<double>(end - start)/repeats;
+
+    std::cout<<"Size: "<<Size<<" softmax: "<<softmax_time<<" log softmax: "<<log_softmax_time<<" sample: "<<sample_time<<" get_action_id: "<<action_time<<" sum: "<<sum<<" "<<actions<<std::endl;
+}
+
+/*
+    Streams repeat after the same seed, uniforms stay in (0,1) and moments of
+    both distributions match, also in remainders and SIMDVector padding.
+*/
+void test_random()
+{
+    const size_t count = 100000;
+
+    snn::set_random_seed(42);
+
+    std::vector<number> first(count);
+
+    for(number& value : first)
+    {
+        value = snn::thread_random().uniform();
+    }
+
+    snn::set_random_seed(42);
+
+    double mean = 0.0;
+    double square = 0.0;
+
+    for(size_t i=0;i<count;++i)
+    {
+        const number value = snn::thread_random().uniform();
+
+        assert( value == first[i] );
+
+        assert( value > 0.f && value < 1.f );
+
+        mean += value;
+    }
+
+    assert( std::abs(mean/count - 0.5) < 0.01 );
+
+    mean = 0.0;
+
+    for(size_t i=0;i<count;++i)
+    {
+        const number value = snn::thread_random().normal();
+
+        mean += value;
+        square += value*value;
+    }
+
+    mean /= count;
+
+    assert( std::abs(mean) < 0.02 );
+
+    assert( std::abs(square/count - mean*mean - 1.0) < 0.02 );
+
+    snn::SIMDVectorLite<100> lite;
+
+    snn::thread_random().uniform(lite,2.f,3.f);
+
+    for(size_t i=0;i<lite.size();++i)
+    {
+        assert( lite[i] > 2.f && lite[i] < 3.f );
+    }
+
+    snn::SIMDVector vec(0.f,19);
+
+    snn::thread_random().normal(vec,5.f,0.1f);
+
+    assert( std::abs(vec.reduce()/vec.size() - 5.f) < 0.2f );
+}
+
+/*
+    Old initializers owned std::mt19937 seeded from random_device, now they draw
+    from stream of current thread.
+*/
+template<size_t Size>
+void bench_random(size_t repeats)
+{
+    snn::set_random_seed(1);
+
+    auto start = std::chrono::system_clock::now();
+
+    number sum = 0.f;
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        std::random_device rd;
+
+        std::mt19937 gen(rd());
+
+        std::uniform_real_distribution<number> uniform(0.f,1.f);
+
+        sum += uniform(gen);
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    auto construct_time = std::chrono::duration<double>(end - start)/repeats;
+
+    std::mt19937 gen(1);
+
+    std::uniform_real_distribution<number> uniform(0.f,1.f);
+
+    std::normal_distribution<number> gauss(0.f,1.f);
+
+    snn::SIMDVectorLite<Size> vec;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        for(size_t i=0;i<Size;++i)
+        {
+            vec[i] = uniform(gen);
+        }
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto mt_uniform_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        for(size_t i=0;i<Size;++i)
+        {
+            vec[i] = gauss(gen);
+        }
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto mt_normal_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        for(size_t i=0;i<Size;++i)
+        {
+            vec[i] = snn::thread_random().uniform();
+        }
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto scalar_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        snn::thread_random().uniform(vec);
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto uniform_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        snn::thread_random().normal(vec);
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto normal_time = std::chrono::duration<double>(end - start)/repeats;
+
+    std::cout<<"mt19937 with random_device: "<<construct_time<<" "<<sizeof(std::mt19937)<<" bytes, stream: "<<sizeof(snn::RandomStream)<<" bytes"<<std::endl;
+
+    std::cout<<"Size: "<<Size<<" mt19937 uniform: "<<mt_uniform_time<<" normal: "<<mt_normal_time<<" stream scalar uniform: "<<scalar_time<<" SIMD uniform: "<<uniform_time<<" normal: "<<normal_time<<" sum: "<<sum<<std::endl;
+}
+
+/*
+    Philox matches known answers of Random123, numbers drawn in RandomScope of
+    a block don't depend on thread count, and layers built with the same seed
+    have the same weights.
+*/
+void test_counter_random()
+{
+    uint32_t counter[4] = {0,0,0,0};
+
+    snn::philox4x32(counter,0u,0u);
+
+    assert( counter[0] == 0x6627e8d5u && counter[1] == 0xe169c58du && counter[2] == 0xbc57ac4cu && counter[3] == 0x9b00dbd8u );
+
+    uint32_t ones[4] = {~0u,~0u,~0u,~0u};
+
+    snn::philox4x32(ones,~0u,~0u);
+
+    assert( ones[0] == 0x408f276du && ones[1] == 0x41c83b0eu && ones[2] == 0xa20bc7c6u && ones[3] == 0x6d5451fdu );
+
+    const size_t blocks = 64;
+
+    auto draw = [](std::vector<number>& output,size_t i){
+
+        snn::RandomScope scope(7,1,i,3);
+
+        snn::SIMDVectorLite<40> vec;
+
+        snn::random_normal(vec);
+
+        output[i] = vec.reduce() + snn::random_uniform();
+    };
+
+    std::vector<number> serial(blocks);
+
+    for(size_t i=0;i<blocks;++i)
+    {
+        draw(serial,i);
+    }
+
+    for(size_t threads : {1,3,8})
+    {
+        snn::ThreadPool pool(threads);
+
+        std::vector<number> parallel(blocks);
+
+        pool.parallel(blocks,[&](size_t i){ draw(parallel,i); });
+
+        assert( parallel == serial );
+    }
+
+    assert( snn::scoped_random() == nullptr );
+
+    std::stringstream first;
+    std::stringstream second;
+    std::stringstream other;
+    std::stringstream other_layer;
+
+    snn::EvoKanLayer<16,8> layer_a(8,5);
+
+    // layers made in between don't change weights of seeded ones
+    snn::EvoKanLayer<16,8> unseeded(8);
+
+    snn::EvoKanLayer<16,8> layer_b(8,5);
+
+    snn::EvoKanLayer<16,8> layer_c(8,6);
+
+    snn::EvoKanLayer<16,8> layer_d(8,5,1);
+
+    layer_a.save(first);
+    layer_b.save(second);
+    layer_c.save(other);
+    layer_d.save(other_layer);
+
+    assert( first.str() == second.str() );
+
+    assert( first.str() != other.str() );
+
+    assert( first.str() != other_layer.str() );
+
+    // without seed weights follow global seed and order of construction
+    std::stringstream global_first;
+    std::stringstream global_second;
+
+    snn::set_random_seed(11);
+
+    snn::EvoKanLayer<16,8> global_a(8);
+
+    snn::set_random_seed(11);
+
+    snn::EvoKanLayer<16,8> global_b(8);
+
+    global_a.save(global_first);
+    global_b.save(global_second);
+
+    assert( global_first.str() == global_second.str() );
+}
+
+/*
+    Cost of keyed stream, it is created for every block and step, so it has to
+    be cheap to set up.
+*/
+template<size_t Size>
+void bench_counter_random(size_t repeats)
+{
+    snn::SIMDVectorLite<Size> vec;
+
+    number sum = 0.f;
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        snn::RandomScope scope(1,2,r,4);
+
+        sum += snn::random_uniform();
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    auto scope_time = std::chrono::duration<double>(end - start)/repeats;
+
+    snn::RandomScope scope(1,2,3,4);
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        snn::random_uniform(vec);
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto uniform_time = std::chrono::duration<double>(end - start)/repeats;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        snn::random_normal(vec);
+
+        sum += vec[r%Size];
+    }
+
+    end = std::chrono::system_clock::now();
+
+    auto normal_time = std::chrono::duration<double>(end - start)/repeats;
+
+    std::cout<<"Size: "<<Size<<" scope with first number: "<<scope_time<<" counter uniform: "<<uniform_time<<" normal: "<<normal_time<<" sum: "<<sum<<std::endl;
+}
+
+/*
+    Populations survive save and load, a layer loaded from a stream fires the
+    same outputs and keeps evolving like the saved one.
+*/
+void test_layer_kac()
+{
+    snn::LayerKAC<64,8,20> layer(21);
+
+    layer.setup();
+
+    snn::SIMDVectorLite<64> input(0.5f);
+
+    for(size_t s=0;s<1000;++s)
+    {
+        input[s%64] = 0.01f*(s%17);
+
+        layer.fire(input);
+
+        layer.applyReward(-10.0);
+
+        layer.shuttle();
+    }
+
+    std::stringstream stream;
+
+    assert( layer.save(stream) == 0 );
+
+    snn::LayerKAC<64,8,20> loaded(21);
+
+    assert( loaded.load(stream) == 0 );
+
+    snn::SIMDVectorLite<8> expected = layer.fire(input);
+
+    snn::SIMDVectorLite<8> output = loaded.fire(input);
+
+    for(size_t i=0;i<8;++i)
+    {
+        assert( output[i] == expected[i] );
+
+        assert( std::isfinite(output[i]) );
+    }
+}
+
+/*
+    A training step of LayerKAC, strong punishment makes every second input
+    switch its worker, so populations evolve every 160 steps.
+*/
+template<size_t inputSize,size_t N,size_t Populus>
+void bench_layer_kac(size_t steps)
+{
+    snn::LayerKAC<inputSize,N,Populus> layer(1);
+
+    layer.setup();
+
+    snn::SIMDVectorLite<inputSize> input(0.5f);
+
+    std::chrono::duration<double> fire_time(0);
+
+    std::chrono::duration<double> evolve_time(0);
+
+    number sum = 0.f;
+
+    for(size_t s=0;s<steps;++s)
+    {
+        input[s%inputSize] = 0.01f*(s%17);
+
+        auto start = std::chrono::system_clock::now();
+
+        snn::SIMDVectorLite<N> output = layer.fire(input);
+
+        auto end = std::chrono::system_clock::now();
+
+        fire_time += end - start;
+
+        sum += output[s%N];
+
+        start = std::chrono::system_clock::now();
+
+        layer.applyReward(-10.0);
+
+        layer.shuttle();
+
+        end = std::chrono::system_clock::now();
+
+        evolve_time += end - start;
+    }
+
+    std::cout<<"LayerKAC<"<<inputSize<<","<<N<<","<<Populus<<"> fire: "<<fire_time/steps<<" reward and shuttle: "<<evolve_time/steps<<" sum: "<<sum<<std::endl;
+}
+
+/*
+    Train a layer, compile it into a read-only layer, SplineGrid by default, and
+    compare fire latency and outputs of both.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass,class CompiledSpline = snn::SplineGrid<>>
+void bench_compile(size_t epochs)
+{
+    const size_t batch_size = 32;
+
+    const size_t repeats = 10;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> inputs(batch_size);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> targets(batch_size);
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            inputs[s][i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            targets[s][i] = uniform.init();
+        }
+    }
+
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer;
+
+    for(size_t e=0;e<epochs;++e)
+    {
+        layer.fit_batch(inputs.data(),targets.data(),batch_size);
+    }
+
+    snn::EvoKanLayer<inputSize,outputSize,CompiledSpline> compiled;
+
+    auto start = std::chrono::system_clock::now();
+
+    number max_error = compiled.compile(layer);
+
+    auto end = std::chrono::system_clock::now();
+
+    std::cout<<"Compile time: "<<std::chrono::duration<double>(end - start)<<" max spline error: "<<max_error<<" spline size: "<<sizeof(CompiledSpline)<<" bytes"<<std::endl;
+
+    number max_output_error = 0.f;
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        snn::SIMDVectorLite<outputSize> diff = layer.fire(inputs[s]) - compiled.fire(inputs[s]);
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            max_output_error = std::max<number>(max_output_error,abs(diff[i]));
+        }
+    }
+
+    std::cout<<"Max output error: "<<max_output_error<<std::endl;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        for(size_t s=0;s<batch_size;++s)
+        {
+            layer.fire(inputs[s]);
+        }
+    }
+
+    end = std::chrono::system_clock::now();
+
+    std::cout<<"Source fire time: "<<std::chrono::duration<double>(end - start)/(repeats*batch_size)<<std::endl;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t r=0;r<repeats;++r)
+    {
+        for(size_t s=0;s<batch_size;++s)
+        {
+            compiled.fire(inputs[s]);
+        }
+    }
+
+    end = std::chrono::system_clock::now();
+
+    std::cout<<"Compiled fire time: "<<std::chrono::duration<double>(end - start)/(repeats*batch_size)<<std::endl;
+}
+
+/*
+    Fire one layer from many threads at once and check that every thread gets
+    the same outputs as a single threaded fire.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void test_concurrent_fire(const snn::EvoKanLayer<inputSize,outputSize,SplineClass>& layer,const snn::SIMDVectorLite<inputSize>& input)
+{
+    const size_t thread_count = 8;
+
+    const size_t repeats = 16;
+
+    const snn::SIMDVectorLite<outputSize> expected = layer.fire(input);
+
+    std::atomic<size_t> mismatches(0);
+
+    std::vector<std::thread> threads;
+
+    for(size_t t=0;t<thread_count;++t)
+    {
+        threads.push_back(std::thread([&]{
+
+            for(size_t r=0;r<repeats;++r)
+            {
+                const snn::SIMDVectorLite<outputSize> output = layer.fire(input);
+
+                for(size_t i=0;i<outputSize;++i)
+                {
+                    if( output[i] != expected[i] )
+                    {
+                        mismatches++;
+                    }
+                }
+            }
+
+        }));
+    }
+
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    if( mismatches.load() != 0 )
+    {
+        std::cout<<"Concurrent fire mismatches: "<<mismatches.load()<<std::endl;
+
+        return;
+    }
+
+    std::cout<<"Passed"<<std::endl;
+}
+
+/*
+    Keep firing online layer from a control thread at fixed rate, while main thread
+    trains it and publishes new versions. Reports slowest fire seen by control thread.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_online_layer(size_t epochs)
+{
+    const size_t batch_size = 16;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> inputs(batch_size);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> targets(batch_size);
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            inputs[s][i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            targets[s][i] = uniform.init();
+        }
+    }
+
+    snn::EvoKanLayerOnline<inputSize,outputSize,SplineClass> layer;
+
+    std::atomic<bool> training(true);
+
+    std::atomic<size_t> fires(0);
+
+    double slowest = 0;
+
+    std::thread control([&]{
+
+        while( training.load() )
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            layer.fire(inputs[fires.load()%batch_size]);
+
+            auto end = std::chrono::steady_clock::now();
+
+            slowest = std::max<double>(slowest,std::chrono::duration<double>(end - start).count());
+
+            fires++;
+
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(1));
+        }
+
+    });
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(size_t e=0;e<epochs;++e)
+    {
+        layer.fit_batch(inputs.data(),targets.data(),batch_size);
+
+        layer.publish();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    training = false;
+
+    control.join();
+
+    std::cout<<"Trained and published "<<epochs<<" times in "<<std::chrono::duration<double>(end - start)<<", control fires: "<<fires.load()<<" slowest fire: "<<slowest<<" s"<<std::endl;
+}
+
+/*
+    Check that parallel() waiting for its own tasks isn't held up by long tasks
+    of another caller, and that exception from a task reaches the caller.
+*/
+void test_thread_pool()
+{
+    snn::ThreadPool& pool = snn::ThreadPool::global();
+
+    const auto task_time = std::chrono::milliseconds(20);
+
+    std::thread slow([&]{
+
+        pool.parallel(4*pool.size()+4,[&](size_t){ std::this_thread::sleep_for(task_time); });
+
+    });
+
+    // let slow caller fill the queues
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    std::atomic<size_t> done(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    pool.parallel(16,[&](size_t){ done++; });
+
+    const auto waited = std::chrono::steady_clock::now() - start;
+
+    slow.join();
+
+    if( done.load() != 16 || waited >= task_time )
+    {
+        std::cout<<"Parallel call waited for tasks of other caller: "<<std::chrono::duration<double>(waited)<<std::endl;
+
+        return;
+    }
+
+    bool caught = false;
+
+    try
+    {
+        pool.parallel(64,[](size_t i){
+
+            if( i == 7 )
+            {
+                throw std::runtime_error("task failed");
+            }
+
+        });
+    }
+    catch(const std::runtime_error&)
+    {
+        caught = true;
+    }
+
+    if( !caught )
+    {
+        std::cout<<"Exception from task was lost"<<std::endl;
+
+        return;
+    }
+
+    std::cout<<"Passed"<<std::endl;
+}
+
+/*
+    Fire online layer while another thread keeps fitting it, and check that no fire
+    takes as long as a single fit_batch, so fire never waits for training work.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void test_online_fire_latency(size_t fires)
+{
+    const size_t batch_size = 16;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> inputs(batch_size);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> targets(batch_size);
+
+    for(size_t s=0;s<batch_size;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            inputs[s][i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            targets[s][i] = uniform.init();
+        }
+    }
+
+    snn::EvoKanLayerOnline<inputSize,outputSize,SplineClass> layer;
+
+    auto start = std::chrono::steady_clock::now();
+
+    layer.fit_batch(inputs.data(),targets.data(),batch_size);
+
+    const double fit_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::atomic<bool> training(true);
+
+    std::thread trainer([&]{
+
+        while( training.load() )
+        {
+            layer.fit_batch(inputs.data(),targets.data(),batch_size);
+
+            layer.publish();
+        }
+
+    });
+
+    double slowest = 0;
+
+    for(size_t f=0;f<fires;++f)
+    {
+        start = std::chrono::steady_clock::now();
+
+        layer.fire(inputs[f%batch_size]);
+
+        slowest = std::max<double>(slowest,std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    training = false;
+
+    trainer.join();
+
+    if( slowest >= fit_time )
+    {
+        std::cout<<"Online fire waited for training, slowest fire: "<<slowest<<" s, fit_batch: "<<fit_time<<" s"<<std::endl;
+
+        return;
+    }
+
+    std::cout<<"Passed, slowest fire: "<<slowest<<" s, fit_batch: "<<fit_time<<" s"<<std::endl;
+}
+
+template<size_t Size>
+number max_difference(const snn::SIMDVectorLite<Size>& a,const snn::SIMDVectorLite<Size>& b)
+{
+    number max_error = 0.f;
+
+    for(size_t i=0;i<Size;++i)
+    {
+        max_error = std::max<number>(max_error,abs(a[i] - b[i]));
+    }
+
+    return max_error;
+}
+
+/*
+    Batched fire gives the same outputs as firing every sample on its own, batch is
+    longer than EVO_KAN_BATCH_TILE so it also covers a partial tile.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void test_batched_fire()
+{
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer(8,5);
+
+    snn::UniformInit<(number)-3.f,(number)3.f> uniform;
+
+    const size_t count = EVO_KAN_BATCH_TILE + 6;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> inputs(count);
+
+    std::vector<snn::SIMDVectorLite<outputSize>> outputs(count);
+
+    for(auto& input : inputs)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            input[i] = uniform.init();
+        }
+    }
+
+    snn::SIMDVectorLite<outputSize> target;
+
+    for(size_t s=0;s<count;++s)
+    {
+        for(size_t i=0;i<outputSize;++i)
+        {
+            target[i] = uniform.init();
+        }
+
+        layer.fit(inputs[s],target);
+    }
+
+    layer.fire(inputs.data(),count,outputs.data());
+
+    for(size_t s=0;s<count;++s)
+    {
+        assert( max_difference(outputs[s],layer.fire(inputs[s])) < 1e-4f );
+    }
+}
+
+/*
+    fire_and_fit returns output of fire from before the update, and leaves layer in
+    the same state as fire followed by fit does on a copy.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void test_fire_and_fit()
+{
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer(8,6);
+
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> twin(8,7);
+
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> untrained(8,7);
+
+    twin.copy_from(layer);
+
+    untrained.copy_from(layer);
+
+    snn::UniformInit<(number)-3.f,(number)3.f> uniform;
+
+    snn::SIMDVectorLite<inputSize> input;
+
+    snn::SIMDVectorLite<outputSize> target;
+
+    for(size_t s=0;s<20;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            input[i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            target[i] = uniform.init();
+        }
+
+        const snn::SIMDVectorLite<outputSize> expected = layer.fire(input);
+
+        assert( max_difference(layer.fire_and_fit(input,target),expected) < 1e-4f );
+
+        twin.fit(input,twin.fire(input),target);
+
+        assert( max_difference(layer.fire(input),twin.fire(input)) < 1e-4f );
+    }
+
+    // fits did change layer, so above isn't compared on untouched splines
+    assert( max_difference(layer.fire(input),untrained.fire(input)) > 1e-2f );
+}
+
+/*
+    Sparse fire gives the same outputs as dense fire of the same input, without
+    cached baseline, with baseline from set_background and after fit drops it.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void test_sparse_fire()
+{
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer(8,3);
+
+    snn::UniformInit<(number)-3.f,(number)3.f> uniform;
+
+    snn::UniformInit<(number)0.f,(number)1.f> chooser;
+
+    snn::SIMDVectorLite<inputSize> input;
+
+    snn::SIMDVectorLite<outputSize> target;
+
+    // some training, so splines aren't flat
+    for(size_t s=0;s<20;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            input[i] = uniform.init();
+        }
+
+        for(size_t i=0;i<outputSize;++i)
+        {
+            target[i] = uniform.init();
+        }
+
+        layer.fit(input,target);
+    }
+
+    snn::SIMDVectorLite<inputSize> dense;
+
+    for(size_t i=0;i<inputSize;++i)
+    {
+        dense[i] = chooser.init() < 0.1f ? uniform.init() : 0.f;
+    }
+
+    snn::SparseInput<inputSize> sparse;
+
+    sparse.assign(dense);
+
+    assert( max_difference(layer.fire(sparse),layer.fire(dense)) < 1e-4f );
+
+    layer.set_background(0.f);
+
+    assert( max_difference(layer.fire(sparse),layer.fire(dense)) < 1e-4f );
+
+    layer.fit(dense,target);
+
+    assert( max_difference(layer.fire(sparse),layer.fire(dense)) < 1e-4f );
+}
+
+/*
+    Compare dense and sparse fire of a layer for input where only given fraction
+    of values isn't zero.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_sparse_fire(snn::EvoKanLayer<inputSize,outputSize,SplineClass>& layer,number density)
+{
+    const size_t samples = 16;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    snn::UniformInit<(number)0.f,(number)1.f> chooser;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> dense(samples);
+
+    std::vector<snn::SparseInput<inputSize>> sparse(samples);
+
+    for(size_t s=0;s<samples;++s)
+    {
+        for(size_t i=0;i<inputSize;++i)
+        {
+            dense[s][i] = chooser.init() < density ? uniform.init() : 0.f;
+        }
+
+        sparse[s].assign(dense[s]);
+    }
+
+    layer.set_background(0.f);
+
+    number max_error = 0.f;
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t s=0;s<samples;++s)
+    {
+        layer.fire(dense[s]);
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    const auto dense_time = std::chrono::duration<double>(end - start)/samples;
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t s=0;s<samples;++s)
+    {
+        layer.fire(sparse[s]);
+    }
+
+    end = std::chrono::system_clock::now();
+
+    const auto sparse_time = std::chrono::duration<double>(end - start)/samples;
+
+    for(size_t s=0;s<samples;++s)
+    {
+        max_error = std::max<number>(max_error,max_difference(layer.fire(dense[s]),layer.fire(sparse[s])));
+    }
+
+    std::cout<<"Density: "<<density<<" dense fire: "<<dense_time<<" sparse fire: "<<sparse_time<<" max difference: "<<max_error<<std::endl;
+}
+
+/*
+    Incremental fire gives the same outputs as dense fire when a few inputs change
+    between frames, after fit changes blocks and across refreshes of running sums.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void test_incremental_fire()
+{
+    snn::EvoKanLayer<inputSize,outputSize,SplineClass> layer(8,4);
+
+    snn::UniformInit<(number)-3.f,(number)3.f> uniform;
+
+    snn::SIMDVectorLite<inputSize> input;
+
+    snn::SIMDVectorLite<outputSize> target;
+
+    for(size_t i=0;i<inputSize;++i)
+    {
+        input[i] = uniform.init();
+    }
+
+    for(size_t i=0;i<outputSize;++i)
+    {
+        target[i] = uniform.init();
+    }
+
+    layer.fit(input,target);
+
+    const size_t refresh_interval = 4;
+
+    snn::EvoKanIncremental<inputSize,outputSize> state(0.f,refresh_interval);
+
+    assert( max_difference(layer.fire(input,state),layer.fire(input)) < 1e-4f );
+
+    // enough frames to pass refresh interval a few times
+    for(size_t f=0;f<3*refresh_interval;++f)
+    {
+        for(size_t c=0;c<3;++c)
+        {
+            input[(f*7 + c*13)%inputSize] = uniform.init();
+        }
+
+        assert( max_difference(layer.fire(input,state),layer.fire(input)) < 1e-4f );
+
+        // fit gives blocks new versions, their cached values are stale
+        if( f%3 == 0 )
+        {
+            layer.fit(input,target);
+
+            assert( max_difference(layer.fire(input,state),layer.fire(input)) < 1e-4f );
+        }
+    }
+}
+
+/*
+    Compare dense and incremental fire of a layer for a stream of frames where
+    only given amount of inputs changes between frames.
+*/
+template<size_t inputSize,size_t outputSize,class SplineClass>
+void bench_incremental_fire(snn::EvoKanLayer<inputSize,outputSize,SplineClass>& layer,size_t changes)
+{
+    const size_t frames = 64;
+
+    snn::UniformInit<(number)-5.f,(number)5.f> uniform;
+
+    snn::UniformInit<(number)0.f,(number)1.f> chooser;
+
+    std::vector<snn::SIMDVectorLite<inputSize>> stream(frames);
+
+    for(size_t i=0;i<inputSize;++i)
+    {
+        stream[0][i] = uniform.init();
+    }
+
+    for(size_t f=1;f<frames;++f)
+    {
+        stream[f] = stream[f-1];
+
+        for(size_t c=0;c<changes;++c)
+        {
+            stream[f][static_cast<size_t>(chooser.init()*(inputSize-1))] = uniform.init();
+        }
+    }
+
+    snn::EvoKanIncremental<inputSize,outputSize> state;
+
+    // first fire fills the state
+    layer.fire(stream[0],state);
+
+    auto start = std::chrono::system_clock::now();
+
+    for(size_t f=1;f<frames;++f)
+    {
+        layer.fire(stream[f]);
+    }
+
+    auto end = std::chrono::system_clock::now();
+
+    const auto dense_time = std::chrono::duration<double>(end - start)/(frames-1);
+
+    start = std::chrono::system_clock::now();
+
+    for(size_t f=1;f<frames;++f)
+    {
+        layer.fire(stream[f],state);
+    }
+
+    end = std::chrono::system_clock::now();
+
+    const auto incremental_time = std::chrono::duration<double>(end - start)/(frames-1);
+
+    const number max_error = max_difference(layer.fire(stream[frames-1]),layer.fire(stream[frames-1],state));
+
+    std::cout<<"Changed inputs: "<<changes<<" dense fire: "<<dense_time<<" incremental fire: "<<incremental_time<<" max difference: "<<max_error<<std::endl;
+}
+
+
+int main(int argc,char** argv)
+{
+    const bool bench = argc > 1 && std::string_view(argv[1]) == "bench";
+
+    std::cout<<"SIMD math accuracy test"<<std::endl;
+    test_simd_math<100000>();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Random numbers test"<<std::endl;
+    test_random();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Counter random numbers test"<<std::endl;
+    test_counter_random();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"LayerKAC test"<<std::endl;
+    test_layer_kac();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Softmax test"<<std::endl;
+    test_softmax<64>();
+    test_softmax<19>();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Thread pool test"<<std::endl;
+    test_thread_pool();
+
+    std::cout<<"Online layer fire latency test"<<std::endl;
+    test_online_fire_latency<1024,64,snn::Spline>(50);
+
+    // same layer as in main, 128x128 monochromatic image in
+    snn::EvoKanLayer<4096,64,snn::SplineStatic<32>> kan;
+
+    snn::UniformInit<(number)-0.5f,(number)0.5f> noise;
+
+    snn::SIMDVectorLite<4096> input;
+
+    for(size_t i=0;i<4096;++i)
+    {
+        input[i] = noise.init()*10.f;
+    }
+
+    std::cout<<"Batched fire test"<<std::endl;
+    test_batched_fire<37,19,snn::Spline>();
+    test_batched_fire<37,19,snn::SplineStatic<32>>();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Fire and fit test"<<std::endl;
+    test_fire_and_fit<37,19,snn::Spline>();
+    test_fire_and_fit<37,19,snn::SplineStatic<32>>();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Sparse fire test"<<std::endl;
+    test_sparse_fire<37,19,snn::Spline>();
+    test_sparse_fire<37,19,snn::SplineStatic<32>>();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Incremental fire test"<<std::endl;
+    test_incremental_fire<37,19,snn::Spline>();
+    test_incremental_fire<37,19,snn::SplineStatic<32>>();
+    std::cout<<"Passed"<<std::endl;
+
+    std::cout<<"Concurrent fire test"<<std::endl;
+    test_concurrent_fire(kan,input);
+
+    if( !bench )
+    {
+        return 0;
+    }
+
+    std::cout<<"SIMD math benchmark"<<std::endl;
+    bench_simd_math<4096>(1000);
+
+    std::cout<<"Random numbers benchmark"<<std::endl;
+    bench_random<4096>(1000);
+
+    std::cout<<"Counter random numbers benchmark"<<std::endl;
+    bench_counter_random<4096>(1000);
+
+    std::cout<<"LayerKAC benchmark"<<std::endl;
+    bench_layer_kac<256,64,20>(4000);
+
+    std::cout<<"Softmax benchmark"<<std::endl;
+    bench_softmax<64>(100000);
+
+    std::cout<<"SIMD dispatch benchmark"<<std::endl;
+    bench_simd_dispatch<4096,64>(20);
+
+    std::cout<<"Vector expression benchmark"<<std::endl;
+    bench_vector_expression<4096>(10000);
+    bench_vector_expression<100>(100000);
+
+    std::cout<<"Vector storage benchmark"<<std::endl;
+    bench_vector_storage<4096>(1000);
+    bench_vector_storage<256>(1000);
+
+    std::cout<<"Layer allocation benchmark"<<std::endl;
+    bench_layer_allocation<4096,64,snn::Spline>(32);
+
+    std::cout<<"Batched fit benchmark"<<std::endl;
+    bench_fit_batch<256,16,snn::Spline>(100);
+
+    std::cout<<"Compiled layer benchmark"<<std::endl;
+    bench_compile<1024,64,snn::Spline>(20);
+    bench_compile<1024,64,snn::SplineStatic<32>>(20);
+
+    std::cout<<"Quantized layer benchmark"<<std::endl;
+    bench_compile<1024,64,snn::Spline,snn::SplineQuantized<>>(20);
+    bench_compile<1024,64,snn::SplineStatic<32>,snn::SplineQuantized<>>(20);
+    bench_compile<1024,64,snn::SplineStatic<32>,snn::SplineQuantized<64,int16_t>>(20);
+
+    std::cout<<"Spline storage benchmark"<<std::endl;
+    bench_spline_storage<4096,64,snn::SplineStatic<32,float>>(5);
+    bench_spline_storage<4096,64,snn::SplineStatic<32,snn::half>>(5);
+    bench_spline_storage<4096,64,snn::SplineStatic<32,snn::bfloat16>>(5);
+
+    bench_spline_storage<4096,64,snn::BasicSpline<float>>(5);
+    bench_spline_storage<4096,64,snn::BasicSpline<snn::half>>(5);
+    bench_spline_storage<4096,64,snn::BasicSpline<snn::bfloat16>>(5);
+
+    std::cout<<"Shared knots layer benchmark"<<std::endl;
+    bench_shared_layer<4096,64,32>(50);
+
+    std::cout<<"Online layer benchmark"<<std::endl;
+    bench_online_layer<256,16,snn::Spline>(100);
+
+    std::cout<<"Layer scaling benchmark"<<std::endl;
+    bench_layer_scaling(kan,input);
+
+    std::cout<<"Sparse fire benchmark"<<std::endl;
+    bench_sparse_fire(kan,0.05f);
+    bench_sparse_fire(kan,0.1f);
+
+    std::cout<<"Incremental fire benchmark"<<std::endl;
+    bench_incremental_fire(kan,16);
+    bench_incremental_fire(kan,256);
+
+    return 0;
+}